@@ -0,0 +1,204 @@
+/*
+   Copyright (c) 2025, MariaDB ScyllaDB Storage Engine
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; version 2 of the License.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+/**
+ * Microbenchmark of per-row INSERT generation cost
+ *
+ * Compares the two ways write_row() turns a row into a statement:
+ *  - literal: build_insert_cql() rebuilds the column list and formats every
+ *    value into the CQL text, which is then wrapped in an unbound statement
+ *  - template: the INSERT template is built once and each row only binds
+ *    its values to a statement with bind markers
+ *
+ * Field and TABLE only exist inside the server, so the rows are plain
+ * structs formatted and bound exactly as ScyllaTypes::get_cql_value() and
+ * ScyllaTypes::bind_field_value() do for INT, BIGINT, DOUBLE and VARCHAR.
+ * A prepared statement needs a cluster, so the template path binds to a
+ * statement created from the template text, which costs the same as
+ * cass_prepared_bind() on the client.
+ *
+ * Usage: scylla_insert_bench [rows]
+ */
+
+#include <cassandra.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static const char *KEYSPACE = "bench";
+static const char *TABLE_NAME = "users";
+static const char *COLUMNS[] = {"id", "visits", "score", "name"};
+static const size_t COLUMN_COUNT = sizeof(COLUMNS) / sizeof(COLUMNS[0]);
+
+struct BenchRow
+{
+  int id;
+  long long visits;
+  double score;
+  std::string name;
+};
+
+/**
+ * Same escaping as ScyllaTypes::escape_string()
+ */
+static std::string escape_string(const std::string &str)
+{
+  std::string result;
+  result.reserve(str.length() * 2);
+
+  for (char c : str) {
+    if (c == '\'') {
+      result += "''";
+    } else {
+      result += c;
+    }
+  }
+
+  return result;
+}
+
+/**
+ * Same formatting as ScyllaTypes::get_cql_value(), one stream per value
+ */
+static std::string cql_value(long long value)
+{
+  std::ostringstream oss;
+  oss << value;
+  return oss.str();
+}
+
+static std::string cql_value(double value)
+{
+  std::ostringstream oss;
+  oss << std::setprecision(15) << value;
+  return oss.str();
+}
+
+static std::string cql_value(const std::string &value)
+{
+  std::ostringstream oss;
+  oss << "'" << escape_string(value) << "'";
+  return oss.str();
+}
+
+/**
+ * Same statement text as ScyllaQueryBuilder::build_insert_cql()
+ */
+static std::string build_insert_cql(const BenchRow &row)
+{
+  std::ostringstream columns;
+  for (size_t i = 0; i < COLUMN_COUNT; i++) {
+    if (i > 0) {
+      columns << ", ";
+    }
+    columns << COLUMNS[i];
+  }
+
+  std::ostringstream values;
+  values << cql_value((long long) row.id);
+  values << ", " << cql_value(row.visits);
+  values << ", " << cql_value(row.score);
+  values << ", " << cql_value(row.name);
+
+  std::ostringstream oss;
+  oss << "INSERT INTO " << KEYSPACE << "." << TABLE_NAME << " (";
+  oss << columns.str();
+  oss << ") VALUES (";
+  oss << values.str();
+  oss << ")";
+
+  return oss.str();
+}
+
+/**
+ * Same statement text as ScyllaQueryBuilder::build_insert_template()
+ */
+static std::string build_insert_template()
+{
+  std::string columns;
+  std::string markers;
+
+  for (size_t i = 0; i < COLUMN_COUNT; i++) {
+    columns += (i == 0) ? "" : ", ";
+    columns += COLUMNS[i];
+    markers += (i == 0) ? "?" : ", ?";
+  }
+
+  return std::string("INSERT INTO ") + KEYSPACE + "." + TABLE_NAME +
+         " (" + columns + ") VALUES (" + markers + ")";
+}
+
+/**
+ * Run one generation strategy over all rows
+ * @return Nanoseconds per row
+ */
+template <typename Generate>
+static double time_rows(const std::vector<BenchRow> &rows, Generate generate)
+{
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  for (const BenchRow &row : rows) {
+    CassStatement *statement = generate(row);
+    cass_statement_free(statement);
+  }
+
+  std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+  double nanos = std::chrono::duration<double, std::nano>(end - start).count();
+  return rows.empty() ? 0.0 : nanos / rows.size();
+}
+
+int main(int argc, char **argv)
+{
+  size_t row_count = (argc > 1) ? strtoul(argv[1], NULL, 10) : 1000000;
+
+  std::vector<BenchRow> rows(row_count);
+  for (size_t i = 0; i < row_count; i++) {
+    rows[i].id = (int) i;
+    rows[i].visits = (long long) i * 7919;
+    rows[i].score = i / 3.0;
+    rows[i].name = "user_" + std::to_string(i) + (i % 10 == 0 ? "'s" : "");
+  }
+
+  std::string tpl = build_insert_template();
+
+  double literal_ns = time_rows(rows, [](const BenchRow &row) {
+    std::string cql = build_insert_cql(row);
+    return cass_statement_new(cql.c_str(), 0);
+  });
+
+  double template_ns = time_rows(rows, [&tpl](const BenchRow &row) {
+    CassStatement *statement = cass_statement_new(tpl.c_str(), COLUMN_COUNT);
+    cass_statement_bind_int32(statement, 0, row.id);
+    cass_statement_bind_int64(statement, 1, row.visits);
+    cass_statement_bind_double(statement, 2, row.score);
+    cass_statement_bind_string_n(statement, 3, row.name.data(), row.name.size());
+    return statement;
+  });
+
+  printf("rows: %zu\n", row_count);
+  printf("literal build_insert_cql: %.1f ns/row\n", literal_ns);
+  printf("template binding:         %.1f ns/row\n", template_ns);
+  if (template_ns > 0) {
+    printf("speedup:                  %.2fx\n", literal_ns / template_ns);
+  }
+
+  return 0;
+}
@@ -17,19 +17,26 @@
 
 #include "ha_scylla.h"
 #include "scylla_types.h"
+#include "scylla_single_flight.h"
+#include "scylla_partitioner.h"
 #include <my_global.h>
 #include <sql_class.h>
 #include <sql_plugin.h>
 #include <mysqld_error.h>
+#include <key.h>
 #include <sstream>
 #include <map>
 #include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <set>
 
 // Plugin variables
 static char *scylla_default_hosts = NULL;
 static unsigned int scylla_default_port = 9042;
 static char *scylla_default_keyspace = NULL;
 static my_bool scylla_default_verbose = FALSE;
+static unsigned int scylla_page_size = ScyllaConnection::DEFAULT_PAGE_SIZE;
 
 static MYSQL_SYSVAR_STR(hosts, scylla_default_hosts,
   PLUGIN_VAR_RQCMDARG | PLUGIN_VAR_MEMALLOC,
@@ -51,14 +58,698 @@ static MYSQL_SYSVAR_BOOL(verbose, scylla_default_verbose,
   "Enable verbose logging for ScyllaDB operations (requires log_warnings >= 3)",
   NULL, NULL, FALSE);
 
+static MYSQL_SYSVAR_UINT(page_size, scylla_page_size,
+  PLUGIN_VAR_RQCMDARG,
+  "Number of rows fetched per CQL result page",
+  NULL, NULL, ScyllaConnection::DEFAULT_PAGE_SIZE, 1, 1000000, 0);
+
+// Row cache for primary key lookups, shared by all tables
+static ScyllaRowCache scylla_row_cache;
+static ulonglong scylla_row_cache_size = 0;
+static unsigned int scylla_row_cache_ttl = 1000;
+
+// Source of Scylla_share::cache_epoch values
+static std::atomic<ulonglong> scylla_cache_epochs(0);
+
+static void update_row_cache_size(MYSQL_THD thd, struct st_mysql_sys_var *var,
+                                  void *var_ptr, const void *save)
+{
+  scylla_row_cache_size = *(const ulonglong *) save;
+  scylla_row_cache.set_capacity((size_t) scylla_row_cache_size);
+}
+
+static MYSQL_SYSVAR_ULONGLONG(row_cache_size, scylla_row_cache_size,
+  PLUGIN_VAR_RQCMDARG,
+  "Bytes of memory for caching primary key lookup results (0 = disabled)",
+  NULL, update_row_cache_size, 0, 0, ULONGLONG_MAX, 0);
+
+static MYSQL_SYSVAR_UINT(row_cache_ttl, scylla_row_cache_ttl,
+  PLUGIN_VAR_RQCMDARG,
+  "Milliseconds a cached row may be served; tables override it with "
+  "scylla_cache_ttl in the table comment (0 = do not cache)",
+  NULL, NULL, 1000, 0, UINT_MAX32, 0);
+
+// Coalescing of identical concurrent primary key reads
+static ScyllaSingleFlight scylla_single_flight;
+static my_bool scylla_coalesce_reads = TRUE;
+
+static MYSQL_SYSVAR_BOOL(coalesce_reads, scylla_coalesce_reads,
+  PLUGIN_VAR_RQCMDARG,
+  "Let concurrent reads of the same primary key share one ScyllaDB request",
+  NULL, NULL, TRUE);
+
+// Request routing, applied when a cluster connection is opened
+static my_bool scylla_token_aware_routing = TRUE;
+static my_bool scylla_shuffle_replicas = TRUE;
+
+static MYSQL_SYSVAR_BOOL(token_aware_routing, scylla_token_aware_routing,
+  PLUGIN_VAR_RQCMDARG | PLUGIN_VAR_READONLY,
+  "Send each request straight to a replica (and shard) owning its "
+  "partition instead of any coordinator",
+  NULL, NULL, TRUE);
+
+static MYSQL_SYSVAR_BOOL(shuffle_replicas, scylla_shuffle_replicas,
+  PLUGIN_VAR_RQCMDARG | PLUGIN_VAR_READONLY,
+  "Spread token-aware requests over all replicas of a partition instead "
+  "of preferring the first",
+  NULL, NULL, TRUE);
+
+// Hedging of idempotent requests, applied when a cluster connection is opened
+static unsigned int scylla_speculative_delay = 0;
+static unsigned int scylla_speculative_max_executions = 1;
+
+static MYSQL_SYSVAR_UINT(speculative_delay, scylla_speculative_delay,
+  PLUGIN_VAR_RQCMDARG | PLUGIN_VAR_READONLY,
+  "Milliseconds an idempotent request (reads, and writes carrying a client "
+  "timestamp) may be outstanding before it is also sent to another replica "
+  "(0 = no speculative execution)",
+  NULL, NULL, 0, 0, 60000, 0);
+
+static MYSQL_SYSVAR_UINT(speculative_max_executions, scylla_speculative_max_executions,
+  PLUGIN_VAR_RQCMDARG | PLUGIN_VAR_READONLY,
+  "Maximum speculative executions per request",
+  NULL, NULL, 1, 1, 16, 0);
+
+// Load balancing defaults of tables opened afterwards
+static char *scylla_default_local_dc = NULL;
+static unsigned int scylla_used_hosts_per_remote_dc = 0;
+static my_bool scylla_latency_aware_routing = FALSE;
+static double scylla_latency_exclusion_threshold = 2.0;
+static unsigned int scylla_latency_scale = 100;
+
+static MYSQL_SYSVAR_STR(local_dc, scylla_default_local_dc,
+  PLUGIN_VAR_RQCMDARG | PLUGIN_VAR_MEMALLOC,
+  "Default datacenter to send requests to; tables override it with "
+  "scylla_local_dc in the table comment (empty = all datacenters)",
+  NULL, NULL, "");
+
+static MYSQL_SYSVAR_UINT(used_hosts_per_remote_dc, scylla_used_hosts_per_remote_dc,
+  PLUGIN_VAR_RQCMDARG,
+  "Hosts per remote datacenter used when no host of the local one is up",
+  NULL, NULL, 0, 0, 1000, 0);
+
+static MYSQL_SYSVAR_BOOL(latency_aware_routing, scylla_latency_aware_routing,
+  PLUGIN_VAR_RQCMDARG,
+  "Avoid hosts whose latency exceeds the fastest host's by "
+  "scylla_latency_exclusion_threshold; tables override it with "
+  "scylla_latency_aware in the table comment",
+  NULL, NULL, FALSE);
+
+static MYSQL_SYSVAR_DOUBLE(latency_exclusion_threshold, scylla_latency_exclusion_threshold,
+  PLUGIN_VAR_RQCMDARG,
+  "How many times slower than the fastest host a host may be before "
+  "latency-aware routing avoids it",
+  NULL, NULL, 2.0, 1.0, 100.0, 0);
+
+static MYSQL_SYSVAR_UINT(latency_scale, scylla_latency_scale,
+  PLUGIN_VAR_RQCMDARG,
+  "Milliseconds over which older latency samples lose weight",
+  NULL, NULL, 100, 1, 60000, 0);
+
+// Transport settings, applied when a cluster session is created
+static ulong scylla_compression = 0;
+static unsigned int scylla_io_threads = 0;
+static unsigned int scylla_core_connections_per_host = 0;
+static unsigned int scylla_io_queue_size = 0;
+static my_bool scylla_tcp_nodelay = TRUE;
+static unsigned int scylla_tcp_keepalive = 0;
+
+static const char *scylla_compression_names[] = {"NONE", "LZ4", "SNAPPY", NullS};
+
+static TYPELIB scylla_compression_typelib = {
+  array_elements(scylla_compression_names) - 1,
+  "scylla_compression_typelib",
+  scylla_compression_names,
+  NULL
+};
+
+static MYSQL_SYSVAR_ENUM(compression, scylla_compression,
+  PLUGIN_VAR_RQCMDARG | PLUGIN_VAR_READONLY,
+  "Compression of CQL protocol frames (NONE, LZ4, SNAPPY)",
+  NULL, NULL, 0, &scylla_compression_typelib);
+
+static MYSQL_SYSVAR_UINT(io_threads, scylla_io_threads,
+  PLUGIN_VAR_RQCMDARG | PLUGIN_VAR_READONLY,
+  "Driver I/O threads per cluster session (0 = driver default)",
+  NULL, NULL, 0, 0, 128, 0);
+
+static MYSQL_SYSVAR_UINT(core_connections_per_host, scylla_core_connections_per_host,
+  PLUGIN_VAR_RQCMDARG | PLUGIN_VAR_READONLY,
+  "Connections kept open to each host (0 = driver default)",
+  NULL, NULL, 0, 0, 1024, 0);
+
+static MYSQL_SYSVAR_UINT(io_queue_size, scylla_io_queue_size,
+  PLUGIN_VAR_RQCMDARG | PLUGIN_VAR_READONLY,
+  "Requests that may wait for each driver I/O thread (0 = driver default)",
+  NULL, NULL, 0, 0, 1048576, 0);
+
+static MYSQL_SYSVAR_BOOL(tcp_nodelay, scylla_tcp_nodelay,
+  PLUGIN_VAR_RQCMDARG | PLUGIN_VAR_READONLY,
+  "Disable Nagle's algorithm on connections to ScyllaDB",
+  NULL, NULL, TRUE);
+
+static MYSQL_SYSVAR_UINT(tcp_keepalive, scylla_tcp_keepalive,
+  PLUGIN_VAR_RQCMDARG | PLUGIN_VAR_READONLY,
+  "Seconds of idleness before TCP keepalive probes are sent (0 = no keepalive)",
+  NULL, NULL, 0, 0, 86400, 0);
+
+// Authentication, and the separate role that scans and bulk writes run as
+// so a ScyllaDB service level can give them fewer scheduler shares
+static char *scylla_username = NULL;
+static char *scylla_password = NULL;
+static char *scylla_scan_username = NULL;
+static char *scylla_scan_password = NULL;
+static char *scylla_scan_service_level = NULL;
+static unsigned int scylla_scan_shares = 0;
+
+static MYSQL_SYSVAR_STR(username, scylla_username,
+  PLUGIN_VAR_RQCMDARG | PLUGIN_VAR_READONLY | PLUGIN_VAR_MEMALLOC,
+  "Role to authenticate to ScyllaDB as (empty = no authentication)",
+  NULL, NULL, "");
+
+static MYSQL_SYSVAR_STR(password, scylla_password,
+  PLUGIN_VAR_RQCMDARG | PLUGIN_VAR_READONLY | PLUGIN_VAR_MEMALLOC | PLUGIN_VAR_NOSYSVAR,
+  "Password of scylla_username; only settable at startup, never shown",
+  NULL, NULL, "");
+
+static MYSQL_SYSVAR_STR(scan_username, scylla_scan_username,
+  PLUGIN_VAR_RQCMDARG | PLUGIN_VAR_READONLY | PLUGIN_VAR_MEMALLOC,
+  "Role that full and range scans and bulk inserts run as, in a session of "
+  "their own (empty = use the main session)",
+  NULL, NULL, "");
+
+static MYSQL_SYSVAR_STR(scan_password, scylla_scan_password,
+  PLUGIN_VAR_RQCMDARG | PLUGIN_VAR_READONLY | PLUGIN_VAR_MEMALLOC | PLUGIN_VAR_NOSYSVAR,
+  "Password of scylla_scan_username; only settable at startup, never shown",
+  NULL, NULL, "");
+
+static MYSQL_SYSVAR_STR(scan_service_level, scylla_scan_service_level,
+  PLUGIN_VAR_RQCMDARG | PLUGIN_VAR_READONLY | PLUGIN_VAR_MEMALLOC,
+  "Service level attached to scylla_scan_username when scylla_scan_shares is set",
+  NULL, NULL, "");
+
+static MYSQL_SYSVAR_UINT(scan_shares, scylla_scan_shares,
+  PLUGIN_VAR_RQCMDARG | PLUGIN_VAR_READONLY,
+  "Scheduler shares of scylla_scan_service_level, created and attached to "
+  "scylla_scan_username through the main session on first use (0 = managed "
+  "outside the engine)",
+  NULL, NULL, 0, 0, 1000, 0);
+
+// Clusters whose scan service level was already set up
+static std::mutex scylla_service_levels_mutex;
+static std::set<std::string> scylla_service_levels;
+
+// Rate limits of scans and bulk inserts over all tables and sessions
+static ulonglong scylla_scan_rows_per_sec = 0;
+static ulonglong scylla_scan_bytes_per_sec = 0;
+static ulonglong scylla_write_rows_per_sec = 0;
+static ulonglong scylla_write_bytes_per_sec = 0;
+
+static MYSQL_SYSVAR_ULONGLONG(scan_rows_per_sec, scylla_scan_rows_per_sec,
+  PLUGIN_VAR_RQCMDARG,
+  "Rows per second that full and range scans may read over all sessions; "
+  "tables can set a lower limit of their own (0 = unlimited)",
+  NULL, NULL, 0, 0, ULONGLONG_MAX, 0);
+
+static MYSQL_SYSVAR_ULONGLONG(scan_bytes_per_sec, scylla_scan_bytes_per_sec,
+  PLUGIN_VAR_RQCMDARG,
+  "Bytes of column values per second that full and range scans may read "
+  "over all sessions (0 = unlimited)",
+  NULL, NULL, 0, 0, ULONGLONG_MAX, 0);
+
+static MYSQL_SYSVAR_ULONGLONG(write_rows_per_sec, scylla_write_rows_per_sec,
+  PLUGIN_VAR_RQCMDARG,
+  "Rows per second that multi-row inserts may write over all sessions "
+  "(0 = unlimited)",
+  NULL, NULL, 0, 0, ULONGLONG_MAX, 0);
+
+static MYSQL_SYSVAR_ULONGLONG(write_bytes_per_sec, scylla_write_bytes_per_sec,
+  PLUGIN_VAR_RQCMDARG,
+  "Bytes of row buffers per second that multi-row inserts may write over all "
+  "sessions (0 = unlimited)",
+  NULL, NULL, 0, 0, ULONGLONG_MAX, 0);
+
+static ScyllaRateLimiter scylla_scan_rows_limiter;
+static ScyllaRateLimiter scylla_scan_bytes_limiter;
+static ScyllaRateLimiter scylla_write_rows_limiter;
+static ScyllaRateLimiter scylla_write_bytes_limiter;
+static std::atomic<ulonglong> scylla_scan_throttled_us(0);
+static std::atomic<ulonglong> scylla_write_throttled_us(0);
+
+// Client timestamps, and retries of the writes they make idempotent
+static my_bool scylla_client_timestamps = TRUE;
+static unsigned int scylla_write_retries = 3;
+static unsigned int scylla_retry_backoff = 100;
+static unsigned int scylla_retry_backoff_max = 2000;
+
+static MYSQL_SYSVAR_BOOL(client_timestamps, scylla_client_timestamps,
+  PLUGIN_VAR_RQCMDARG | PLUGIN_VAR_READONLY,
+  "Give every write a monotonic timestamp from this server, which makes "
+  "writes safe to retry and to hedge. Requires synchronized clocks between "
+  "the servers writing the same rows",
+  NULL, NULL, TRUE);
+
+static MYSQL_SYSVAR_UINT(write_retries, scylla_write_retries,
+  PLUGIN_VAR_RQCMDARG,
+  "Times a write failing with a timeout, unavailable or overload error is "
+  "retried (only with scylla_client_timestamps)",
+  NULL, NULL, 3, 0, 100, 0);
+
+static MYSQL_SYSVAR_UINT(retry_backoff, scylla_retry_backoff,
+  PLUGIN_VAR_RQCMDARG,
+  "Milliseconds before the first retry of a write; doubles with each retry",
+  NULL, NULL, 100, 1, 60000, 0);
+
+static MYSQL_SYSVAR_UINT(retry_backoff_max, scylla_retry_backoff_max,
+  PLUGIN_VAR_RQCMDARG,
+  "Maximum milliseconds between retries of a write",
+  NULL, NULL, 2000, 1, 600000, 0);
+
+static my_bool scylla_cdc_invalidation = FALSE;
+static unsigned int scylla_cdc_poll_interval = 1000;
+
+static MYSQL_SYSVAR_BOOL(cdc_invalidation, scylla_cdc_invalidation,
+  PLUGIN_VAR_RQCMDARG | PLUGIN_VAR_READONLY,
+  "Invalidate cached rows changed by other clients by reading the CDC log "
+  "of cached tables (requires CDC enabled on the ScyllaDB tables)",
+  NULL, NULL, FALSE);
+
+static MYSQL_SYSVAR_UINT(cdc_poll_interval, scylla_cdc_poll_interval,
+  PLUGIN_VAR_RQCMDARG | PLUGIN_VAR_READONLY,
+  "Milliseconds between reads of the CDC logs",
+  NULL, NULL, 1000, 10, 3600000, 0);
+
+static MYSQL_THDVAR_ULONGLONG(spill_threshold,
+  PLUGIN_VAR_RQCMDARG,
+  "Bytes of scan results kept in memory before further rows are spilled "
+  "to a temporary file (0 = never spill)",
+  NULL, NULL, 0, 0, ULONGLONG_MAX, 0);
+
+static MYSQL_THDVAR_ULONGLONG(max_result_memory,
+  PLUGIN_VAR_RQCMDARG,
+  "Maximum bytes of ScyllaDB result buffers a query may hold in memory "
+  "(0 = unlimited)",
+  NULL, NULL, 0, 0, ULONGLONG_MAX, 0);
+
+enum scylla_memory_action {
+  SCYLLA_MEMORY_ACTION_ERROR,
+  SCYLLA_MEMORY_ACTION_SPILL
+};
+
+static const char *scylla_memory_action_names[] = {"ERROR", "SPILL", NullS};
+
+static TYPELIB scylla_memory_action_typelib = {
+  array_elements(scylla_memory_action_names) - 1,
+  "scylla_memory_action_typelib",
+  scylla_memory_action_names,
+  NULL
+};
+
+// Consistency levels selectable per session; DEFAULT defers to the table
+// option, then to the driver
+static const char *scylla_consistency_names[] = {
+  "DEFAULT", "ANY", "ONE", "TWO", "THREE", "QUORUM", "ALL",
+  "LOCAL_QUORUM", "EACH_QUORUM", "LOCAL_ONE", NullS
+};
+
+static const CassConsistency scylla_consistency_levels[] = {
+  CASS_CONSISTENCY_UNKNOWN, CASS_CONSISTENCY_ANY, CASS_CONSISTENCY_ONE,
+  CASS_CONSISTENCY_TWO, CASS_CONSISTENCY_THREE, CASS_CONSISTENCY_QUORUM,
+  CASS_CONSISTENCY_ALL, CASS_CONSISTENCY_LOCAL_QUORUM, CASS_CONSISTENCY_EACH_QUORUM,
+  CASS_CONSISTENCY_LOCAL_ONE
+};
+
+static TYPELIB scylla_consistency_typelib = {
+  array_elements(scylla_consistency_names) - 1,
+  "scylla_consistency_typelib",
+  scylla_consistency_names,
+  NULL
+};
+
+static const char *scylla_serial_consistency_names[] = {
+  "DEFAULT", "SERIAL", "LOCAL_SERIAL", NullS
+};
+
+static const CassConsistency scylla_serial_consistency_levels[] = {
+  CASS_CONSISTENCY_UNKNOWN, CASS_CONSISTENCY_SERIAL, CASS_CONSISTENCY_LOCAL_SERIAL
+};
+
+static TYPELIB scylla_serial_consistency_typelib = {
+  array_elements(scylla_serial_consistency_names) - 1,
+  "scylla_serial_consistency_typelib",
+  scylla_serial_consistency_names,
+  NULL
+};
+
+// Execution profiles, applied when a cluster session is created
+static unsigned int scylla_oltp_timeout = 2000;
+static unsigned int scylla_scan_timeout = 60000;
+static unsigned int scylla_bulk_timeout = 0;
+static ulong scylla_oltp_consistency = 0;
+static ulong scylla_scan_consistency = 0;
+static ulong scylla_bulk_consistency = 0;
+
+static MYSQL_SYSVAR_UINT(oltp_timeout, scylla_oltp_timeout,
+  PLUGIN_VAR_RQCMDARG | PLUGIN_VAR_READONLY,
+  "Request timeout in milliseconds of primary key lookups and single-row "
+  "writes (0 = cluster default of 10 seconds)",
+  NULL, NULL, 2000, 0, 3600000, 0);
+
+static MYSQL_SYSVAR_UINT(scan_timeout, scylla_scan_timeout,
+  PLUGIN_VAR_RQCMDARG | PLUGIN_VAR_READONLY,
+  "Request timeout in milliseconds of each page of full and range scans "
+  "(0 = cluster default of 10 seconds)",
+  NULL, NULL, 60000, 0, 3600000, 0);
+
+static MYSQL_SYSVAR_UINT(bulk_timeout, scylla_bulk_timeout,
+  PLUGIN_VAR_RQCMDARG | PLUGIN_VAR_READONLY,
+  "Request timeout in milliseconds of pipelined multi-row writes "
+  "(0 = cluster default of 10 seconds)",
+  NULL, NULL, 0, 0, 3600000, 0);
+
+static MYSQL_SYSVAR_ENUM(oltp_consistency, scylla_oltp_consistency,
+  PLUGIN_VAR_RQCMDARG | PLUGIN_VAR_READONLY,
+  "Consistency level of the oltp execution profile; table, session and "
+  "query settings take precedence",
+  NULL, NULL, 0, &scylla_consistency_typelib);
+
+static MYSQL_SYSVAR_ENUM(scan_consistency, scylla_scan_consistency,
+  PLUGIN_VAR_RQCMDARG | PLUGIN_VAR_READONLY,
+  "Consistency level of the scan execution profile; table, session and "
+  "query settings take precedence",
+  NULL, NULL, 0, &scylla_consistency_typelib);
+
+static MYSQL_SYSVAR_ENUM(bulk_consistency, scylla_bulk_consistency,
+  PLUGIN_VAR_RQCMDARG | PLUGIN_VAR_READONLY,
+  "Consistency level of the bulk execution profile; table, session and "
+  "query settings take precedence",
+  NULL, NULL, 0, &scylla_consistency_typelib);
+
+static MYSQL_THDVAR_ENUM(read_consistency,
+  PLUGIN_VAR_RQCMDARG,
+  "Consistency level of reads; DEFAULT uses the table's "
+  "scylla_read_consistency, then the driver default",
+  NULL, NULL, 0, &scylla_consistency_typelib);
+
+static MYSQL_THDVAR_ENUM(write_consistency,
+  PLUGIN_VAR_RQCMDARG,
+  "Consistency level of writes; DEFAULT uses the table's "
+  "scylla_write_consistency, then the driver default",
+  NULL, NULL, 0, &scylla_consistency_typelib);
+
+static MYSQL_THDVAR_ENUM(serial_consistency,
+  PLUGIN_VAR_RQCMDARG,
+  "Serial consistency level of conditional statements; DEFAULT uses the "
+  "table's scylla_serial_consistency, then the driver default",
+  NULL, NULL, 0, &scylla_serial_consistency_typelib);
+
+static MYSQL_THDVAR_UINT(bulk_insert_concurrency,
+  PLUGIN_VAR_RQCMDARG,
+  "INSERTs of a multi-row insert, and DELETEs of a multi-row delete, kept "
+  "in flight at once; errors are reported at the end of the statement "
+  "(0 or 1 = one row at a time)",
+  NULL, NULL, 32, 0, 4096, 0);
+
+static MYSQL_THDVAR_UINT(bulk_batch_rows,
+  PLUGIN_VAR_RQCMDARG,
+  "Rows per UNLOGGED batch of multi-row inserts and deletes; rows are "
+  "grouped by the node owning their partition and sorted by token "
+  "(0 or 1 = no batches)",
+  NULL, NULL, 16, 0, 1024, 0);
+
+// Batches stay below ScyllaDB's default batch_size_warn_threshold_in_kb
+static const size_t BULK_BATCH_MAX_BYTES = 64 * 1024;
+
+static const char *scylla_bypass_cache_names[] = {"AUTO", "ON", "OFF", NullS};
+
+static TYPELIB scylla_bypass_cache_typelib = {
+  array_elements(scylla_bypass_cache_names) - 1,
+  "scylla_bypass_cache_typelib",
+  scylla_bypass_cache_names,
+  NULL
+};
+
+static MYSQL_THDVAR_ENUM(bypass_cache,
+  PLUGIN_VAR_RQCMDARG,
+  "Whether full scans skip ScyllaDB's row cache so they do not evict the hot "
+  "rows: AUTO uses the table's scylla_bypass_cache, then scans tables of at "
+  "least scylla_bypass_cache_rows rows with BYPASS CACHE",
+  NULL, NULL, SCYLLA_BYPASS_CACHE_AUTO, &scylla_bypass_cache_typelib);
+
+static ulonglong scylla_bypass_cache_rows = 100000;
+
+static MYSQL_SYSVAR_ULONGLONG(bypass_cache_rows, scylla_bypass_cache_rows,
+  PLUGIN_VAR_RQCMDARG,
+  "Estimated row count from which full scans use BYPASS CACHE in AUTO mode "
+  "(0 = never automatically)",
+  NULL, NULL, 100000, 0, ULONGLONG_MAX, 0);
+
+static my_bool scylla_adaptive_write_concurrency = FALSE;
+static unsigned int scylla_max_write_concurrency = 1024;
+
+static MYSQL_SYSVAR_BOOL(adaptive_write_concurrency, scylla_adaptive_write_concurrency,
+  PLUGIN_VAR_RQCMDARG,
+  "Adapt the INSERTs in flight of multi-row inserts to the cluster's "
+  "latency and overload errors, with one limit shared by all sessions "
+  "writing to a cluster; scylla_bulk_insert_concurrency still caps each "
+  "session",
+  NULL, NULL, FALSE);
+
+static MYSQL_SYSVAR_UINT(max_write_concurrency, scylla_max_write_concurrency,
+  PLUGIN_VAR_RQCMDARG,
+  "Upper bound of the adaptive write concurrency of a cluster",
+  NULL, NULL, 1024, 1, 65536, 0);
+
+static my_bool scylla_write_coalescing = FALSE;
+static unsigned int scylla_write_coalesce_window = 200;
+static unsigned int scylla_write_coalesce_batch = 16;
+
+static MYSQL_SYSVAR_BOOL(write_coalescing, scylla_write_coalescing,
+  PLUGIN_VAR_RQCMDARG,
+  "Gather single-row writes of all sessions to a cluster and send them as "
+  "unlogged batches grouped by the node owning their partition",
+  NULL, NULL, FALSE);
+
+static MYSQL_SYSVAR_UINT(write_coalesce_window, scylla_write_coalesce_window,
+  PLUGIN_VAR_RQCMDARG,
+  "Microseconds the first write of a batch waits for writes of other sessions",
+  NULL, NULL, 200, 0, 100000, 0);
+
+static MYSQL_SYSVAR_UINT(write_coalesce_batch, scylla_write_coalesce_batch,
+  PLUGIN_VAR_RQCMDARG,
+  "Maximum writes per coalesced batch",
+  NULL, NULL, 16, 1, 1024, 0);
+
+static MYSQL_THDVAR_ENUM(result_memory_action,
+  PLUGIN_VAR_RQCMDARG,
+  "Action when scylla_max_result_memory is exceeded: ERROR aborts the "
+  "statement, SPILL sends further rows to a temporary file",
+  NULL, NULL, SCYLLA_MEMORY_ACTION_ERROR, &scylla_memory_action_typelib);
+
 static struct st_mysql_sys_var* scylla_system_variables[] = {
   MYSQL_SYSVAR(hosts),
   MYSQL_SYSVAR(port),
   MYSQL_SYSVAR(keyspace),
   MYSQL_SYSVAR(verbose),
+  MYSQL_SYSVAR(page_size),
+  MYSQL_SYSVAR(spill_threshold),
+  MYSQL_SYSVAR(max_result_memory),
+  MYSQL_SYSVAR(result_memory_action),
+  MYSQL_SYSVAR(bypass_cache),
+  MYSQL_SYSVAR(bypass_cache_rows),
+  MYSQL_SYSVAR(bulk_insert_concurrency),
+  MYSQL_SYSVAR(bulk_batch_rows),
+  MYSQL_SYSVAR(adaptive_write_concurrency),
+  MYSQL_SYSVAR(max_write_concurrency),
+  MYSQL_SYSVAR(write_coalescing),
+  MYSQL_SYSVAR(write_coalesce_window),
+  MYSQL_SYSVAR(write_coalesce_batch),
+  MYSQL_SYSVAR(read_consistency),
+  MYSQL_SYSVAR(write_consistency),
+  MYSQL_SYSVAR(serial_consistency),
+  MYSQL_SYSVAR(row_cache_size),
+  MYSQL_SYSVAR(row_cache_ttl),
+  MYSQL_SYSVAR(cdc_invalidation),
+  MYSQL_SYSVAR(cdc_poll_interval),
+  MYSQL_SYSVAR(coalesce_reads),
+  MYSQL_SYSVAR(token_aware_routing),
+  MYSQL_SYSVAR(shuffle_replicas),
+  MYSQL_SYSVAR(speculative_delay),
+  MYSQL_SYSVAR(speculative_max_executions),
+  MYSQL_SYSVAR(local_dc),
+  MYSQL_SYSVAR(used_hosts_per_remote_dc),
+  MYSQL_SYSVAR(latency_aware_routing),
+  MYSQL_SYSVAR(latency_exclusion_threshold),
+  MYSQL_SYSVAR(latency_scale),
+  MYSQL_SYSVAR(compression),
+  MYSQL_SYSVAR(io_threads),
+  MYSQL_SYSVAR(core_connections_per_host),
+  MYSQL_SYSVAR(io_queue_size),
+  MYSQL_SYSVAR(tcp_nodelay),
+  MYSQL_SYSVAR(tcp_keepalive),
+  MYSQL_SYSVAR(oltp_timeout),
+  MYSQL_SYSVAR(scan_timeout),
+  MYSQL_SYSVAR(bulk_timeout),
+  MYSQL_SYSVAR(oltp_consistency),
+  MYSQL_SYSVAR(scan_consistency),
+  MYSQL_SYSVAR(bulk_consistency),
+  MYSQL_SYSVAR(username),
+  MYSQL_SYSVAR(password),
+  MYSQL_SYSVAR(scan_username),
+  MYSQL_SYSVAR(scan_password),
+  MYSQL_SYSVAR(scan_service_level),
+  MYSQL_SYSVAR(scan_shares),
+  MYSQL_SYSVAR(client_timestamps),
+  MYSQL_SYSVAR(write_retries),
+  MYSQL_SYSVAR(retry_backoff),
+  MYSQL_SYSVAR(retry_backoff_max),
+  MYSQL_SYSVAR(scan_rows_per_sec),
+  MYSQL_SYSVAR(scan_bytes_per_sec),
+  MYSQL_SYSVAR(write_rows_per_sec),
+  MYSQL_SYSVAR(write_bytes_per_sec),
   NULL
 };
 
+// Engine memory accounting. Result buffers are charged to the session in
+// chunks so the bookkeeping does not run for every row.
+static const longlong MEMORY_ACCOUNTING_CHUNK = 64 * 1024;
+static std::mutex scylla_memory_mutex;
+static std::map<const THD*, longlong> scylla_session_memory;
+static std::atomic<longlong> scylla_memory_used(0);
+static std::atomic<ulonglong> scylla_memory_limit_hits(0);
+
+/**
+ * Charge (positive delta) or release (negative delta) engine memory for a
+ * session. The bytes also go to the session's Memory_used status so they
+ * show up in the processlist and in the server-wide total.
+ * @return Engine memory now held by the session
+ */
+static longlong scylla_charge_memory(THD *thd, longlong delta)
+{
+  scylla_memory_used += delta;
+  
+  thd->status_var.local_memory_used += delta;
+  if (thd->status_var.local_memory_used > thd->status_var.max_local_memory_used) {
+    thd->status_var.max_local_memory_used = thd->status_var.local_memory_used;
+  }
+  
+  std::lock_guard<std::mutex> lock(scylla_memory_mutex);
+  longlong &session_bytes = scylla_session_memory[thd];
+  session_bytes += delta;
+  longlong total = session_bytes;
+  if (session_bytes == 0) {
+    scylla_session_memory.erase(thd);
+  }
+  
+  return total;
+}
+
+/**
+ * Engine memory currently held by a session
+ */
+static longlong scylla_session_memory_used(const THD *thd)
+{
+  std::lock_guard<std::mutex> lock(scylla_memory_mutex);
+  std::map<const THD*, longlong>::const_iterator it = scylla_session_memory.find(thd);
+  return it == scylla_session_memory.end() ? 0 : it->second;
+}
+
+// Write-behind executors of open handlers; scylla_done_func() waits for
+// their writes before the engine goes away
+static std::mutex scylla_write_behind_mutex;
+static std::set<ScyllaExecutor*> scylla_write_behind_executors;
+static std::atomic<ulonglong> scylla_write_behind_failures(0);
+
+// Status variables
+static int show_scylla_memory_used(MYSQL_THD thd, struct st_mysql_show_var *var,
+                                   void *buff, struct system_status_var *status_var,
+                                   enum enum_var_type scope)
+{
+  var->type = SHOW_LONGLONG;
+  var->value = buff;
+  *(longlong *) buff = (scope == SHOW_OPT_GLOBAL) ? scylla_memory_used.load()
+                                                 : scylla_session_memory_used(thd);
+  return 0;
+}
+
+// Snapshot of the engine counters, refreshed on every SHOW STATUS
+static struct {
+  ulonglong memory_limit_hits;
+  ulonglong row_cache_hits;
+  ulonglong row_cache_misses;
+  ulonglong row_cache_evictions;
+  ulonglong row_cache_invalidations;
+  ulonglong row_cache_used;
+  ulonglong cdc_changes;
+  ulonglong cdc_poll_errors;
+  ulonglong coalesced_reads;
+  ulonglong speculative_executions;
+  ulonglong scan_throttled_us;
+  ulonglong write_throttled_us;
+  ulonglong write_concurrency_limit;
+  ulonglong write_overloads;
+  ulonglong write_retries;
+  ulonglong write_behind_failures;
+  ulonglong write_batches;
+  ulonglong coalesced_writes;
+} scylla_export;
+
+static SHOW_VAR scylla_status_variables[] = {
+  {"memory_used", (char *) &show_scylla_memory_used, SHOW_FUNC},
+  {"memory_limit_hits", (char *) &scylla_export.memory_limit_hits, SHOW_ULONGLONG},
+  {"row_cache_hits", (char *) &scylla_export.row_cache_hits, SHOW_ULONGLONG},
+  {"row_cache_misses", (char *) &scylla_export.row_cache_misses, SHOW_ULONGLONG},
+  {"row_cache_evictions", (char *) &scylla_export.row_cache_evictions, SHOW_ULONGLONG},
+  {"row_cache_invalidations", (char *) &scylla_export.row_cache_invalidations, SHOW_ULONGLONG},
+  {"row_cache_used", (char *) &scylla_export.row_cache_used, SHOW_ULONGLONG},
+  {"cdc_changes", (char *) &scylla_export.cdc_changes, SHOW_ULONGLONG},
+  {"cdc_poll_errors", (char *) &scylla_export.cdc_poll_errors, SHOW_ULONGLONG},
+  {"coalesced_reads", (char *) &scylla_export.coalesced_reads, SHOW_ULONGLONG},
+  {"speculative_executions", (char *) &scylla_export.speculative_executions, SHOW_ULONGLONG},
+  {"scan_throttled_us", (char *) &scylla_export.scan_throttled_us, SHOW_ULONGLONG},
+  {"write_throttled_us", (char *) &scylla_export.write_throttled_us, SHOW_ULONGLONG},
+  {"write_concurrency_limit", (char *) &scylla_export.write_concurrency_limit, SHOW_ULONGLONG},
+  {"write_overloads", (char *) &scylla_export.write_overloads, SHOW_ULONGLONG},
+  {"write_retries", (char *) &scylla_export.write_retries, SHOW_ULONGLONG},
+  {"write_behind_failures", (char *) &scylla_export.write_behind_failures, SHOW_ULONGLONG},
+  {"write_batches", (char *) &scylla_export.write_batches, SHOW_ULONGLONG},
+  {"coalesced_writes", (char *) &scylla_export.coalesced_writes, SHOW_ULONGLONG},
+  {NullS, NullS, SHOW_LONG}
+};
+
+static int show_scylla_vars(MYSQL_THD thd, struct st_mysql_show_var *var,
+                            void *buff, struct system_status_var *status_var,
+                            enum enum_var_type scope)
+{
+  scylla_export.memory_limit_hits = scylla_memory_limit_hits;
+  scylla_export.row_cache_hits = scylla_row_cache.hits;
+  scylla_export.row_cache_misses = scylla_row_cache.misses;
+  scylla_export.row_cache_evictions = scylla_row_cache.evictions;
+  scylla_export.row_cache_invalidations = scylla_row_cache.invalidations;
+  scylla_export.row_cache_used = scylla_row_cache.memory_used();
+  scylla_export.cdc_changes = ScyllaCdcConsumer::changes;
+  scylla_export.cdc_poll_errors = ScyllaCdcConsumer::poll_errors;
+  scylla_export.coalesced_reads = scylla_single_flight.coalesced;
+  scylla_export.speculative_executions = ScyllaConnectionPool::speculative_executions();
+  scylla_export.scan_throttled_us = scylla_scan_throttled_us;
+  scylla_export.write_throttled_us = scylla_write_throttled_us;
+  scylla_export.write_concurrency_limit = ScyllaConnectionPool::write_concurrency_limit();
+  scylla_export.write_overloads = ScyllaConnectionPool::write_overloads();
+  scylla_export.write_retries = ScyllaRetryPolicy::retries;
+  scylla_export.write_behind_failures = scylla_write_behind_failures;
+  scylla_export.write_batches = ScyllaWriteCoalescer::batches;
+  scylla_export.coalesced_writes = ScyllaWriteCoalescer::writes;
+  
+  var->type = SHOW_ARRAY;
+  var->value = (char *) &scylla_status_variables;
+  return 0;
+}
+
+static SHOW_VAR scylla_status_variables_export[] = {
+  {"Scylla", (char *) &show_scylla_vars, SHOW_FUNC},
+  {NullS, NullS, SHOW_LONG}
+};
+
 // Storage engine handlerton
 static handler* scylla_create_handler(handlerton *hton, TABLE_SHARE *table,
                                        MEM_ROOT *mem_root);
@@ -77,6 +768,39 @@ static handler* scylla_create_handler(handlerton *hton, TABLE_SHARE *table,
   return new (mem_root) ha_scylla(hton, table);
 }
 
+/**
+ * Tell the server (and its thread pool) the current thread waits on the
+ * network, so other connections can be scheduled meanwhile
+ */
+static void scylla_wait_begin()
+{
+  thd_wait_begin(NULL, THD_WAIT_NET);
+}
+
+static void scylla_wait_end()
+{
+  thd_wait_end(NULL);
+}
+
+/**
+ * Whether a statement was killed or exceeded max_statement_time. The
+ * timeout is a soft kill, which thd_killed() does not report
+ */
+static bool scylla_statement_interrupted(const THD *thd)
+{
+  return thd && thd_kill_level(thd) != THD_IS_NOT_KILLED;
+}
+
+/**
+ * Stop waiting on ScyllaDB once the current statement is killed or
+ * exceeds max_statement_time; threads without a THD (e.g. the CDC
+ * consumer) are never interrupted
+ */
+static bool scylla_wait_interrupted()
+{
+  return scylla_statement_interrupted(current_thd);
+}
+
 /**
  * Initialize storage engine
  */
@@ -88,6 +812,10 @@ static int scylla_init_func(void *p)
   scylla_hton->create = scylla_create_handler;
   scylla_hton->flags = HTON_NO_FLAGS;
   
+  scylla_row_cache.set_capacity((size_t) scylla_row_cache_size);
+  ScyllaWait::set_hooks(scylla_wait_begin, scylla_wait_end);
+  ScyllaWait::set_interrupt_hook(scylla_wait_interrupted);
+  
   DBUG_RETURN(0);
 }
 
@@ -97,6 +825,22 @@ static int scylla_init_func(void *p)
 static int scylla_done_func(void *p)
 {
   DBUG_ENTER("scylla_done_func");
+  ScyllaWait::set_hooks(NULL, NULL);
+  ScyllaWait::set_interrupt_hook(NULL);
+  
+  // Handlers normally acknowledge their writes when they are closed; wait
+  // for any that are still open so no accepted write is lost
+  {
+    std::lock_guard<std::mutex> lock(scylla_write_behind_mutex);
+    for (ScyllaExecutor *executor : scylla_write_behind_executors) {
+      if (!executor->wait()) {
+        sql_print_warning("Scylla: Write-behind writes failed at shutdown: %s",
+                          executor->first_error().c_str());
+      }
+    }
+  }
+  
+  scylla_row_cache.clear();
   DBUG_RETURN(0);
 }
 
@@ -116,7 +860,7 @@ mysql_declare_plugin(scylla)
   scylla_init_func,
   scylla_done_func,
   0x0100, /* version 1.0 */
-  NULL,
+  scylla_status_variables_export,
   scylla_system_variables,
   NULL,
   MariaDB_PLUGIN_MATURITY_GAMMA
@@ -124,42 +868,106 @@ mysql_declare_plugin(scylla)
 mysql_declare_plugin_end;
 
 /**
- * Constructor
+ * Table options constructor
  */
-ha_scylla::ha_scylla(handlerton *hton, TABLE_SHARE *table_arg)
-  : handler(hton, table_arg),
-    current_position(0),
-    scan_active(false),
-    verbose_logging(scylla_default_verbose),
-    scylla_port(scylla_default_port)
+ScyllaTableOptions::ScyllaTableOptions()
+  : port(9042),
+    verbose(false),
+    cache_ttl(-1),
+    read_consistency(CASS_CONSISTENCY_UNKNOWN),
+    write_consistency(CASS_CONSISTENCY_UNKNOWN),
+    serial_consistency(CASS_CONSISTENCY_UNKNOWN),
+    execution_profile(ScyllaClusterOptions::PROFILE_COUNT),
+    bypass_cache(SCYLLA_BYPASS_CACHE_AUTO),
+    scan_rows_per_sec(0),
+    scan_bytes_per_sec(0),
+    write_rows_per_sec(0),
+    write_bytes_per_sec(0),
+    write_behind(0),
+    duplicate_keys(SCYLLA_DUPLICATE_KEY_UPSERT)
 {
-  thr_lock_init(&thr_lock);
-  if (scylla_default_hosts) {
-    scylla_hosts = scylla_default_hosts;
-  }
-  if (scylla_default_keyspace) {
-    keyspace_name = scylla_default_keyspace;
-  }
 }
 
 /**
- * Destructor
+ * Reset to the global defaults, then apply the table comment
  */
-ha_scylla::~ha_scylla()
+void ScyllaTableOptions::init(const char *comment, const char *name)
 {
-  thr_lock_delete(&thr_lock);
+  hosts = scylla_default_hosts ? scylla_default_hosts : "";
+  port = scylla_default_port;
+  keyspace = scylla_default_keyspace ? scylla_default_keyspace : "";
+  table.clear();
+  verbose = scylla_default_verbose;
+  cache_ttl = -1;
+  read_consistency = CASS_CONSISTENCY_UNKNOWN;
+  write_consistency = CASS_CONSISTENCY_UNKNOWN;
+  serial_consistency = CASS_CONSISTENCY_UNKNOWN;
+  cluster = ScyllaClusterOptions();
+  cluster.token_aware = scylla_token_aware_routing;
+  cluster.shuffle_replicas = scylla_shuffle_replicas;
+  cluster.speculative_delay_ms = scylla_speculative_delay;
+  cluster.speculative_max_executions = scylla_speculative_max_executions;
+  cluster.local_dc = scylla_default_local_dc ? scylla_default_local_dc : "";
+  cluster.used_hosts_per_remote_dc = scylla_used_hosts_per_remote_dc;
+  cluster.latency_aware = scylla_latency_aware_routing;
+  cluster.latency_exclusion_threshold = scylla_latency_exclusion_threshold;
+  cluster.latency_scale_ms = scylla_latency_scale;
+  cluster.compression = (ScyllaClusterOptions::Compression) scylla_compression;
+  cluster.io_threads = scylla_io_threads;
+  cluster.core_connections = scylla_core_connections_per_host;
+  cluster.io_queue_size = scylla_io_queue_size;
+  cluster.tcp_nodelay = scylla_tcp_nodelay;
+  cluster.tcp_keepalive_s = scylla_tcp_keepalive;
+  cluster.client_timestamps = scylla_client_timestamps;
+  
+  ScyllaClusterOptions::ProfileSettings *profiles = cluster.profiles;
+  profiles[ScyllaClusterOptions::PROFILE_OLTP].request_timeout_ms = scylla_oltp_timeout;
+  profiles[ScyllaClusterOptions::PROFILE_OLTP].consistency =
+    scylla_consistency_levels[scylla_oltp_consistency];
+  profiles[ScyllaClusterOptions::PROFILE_SCAN].request_timeout_ms = scylla_scan_timeout;
+  profiles[ScyllaClusterOptions::PROFILE_SCAN].consistency =
+    scylla_consistency_levels[scylla_scan_consistency];
+  profiles[ScyllaClusterOptions::PROFILE_BULK].request_timeout_ms = scylla_bulk_timeout;
+  profiles[ScyllaClusterOptions::PROFILE_BULK].consistency =
+    scylla_consistency_levels[scylla_bulk_consistency];
+  execution_profile = ScyllaClusterOptions::PROFILE_COUNT;
+  cluster.username = scylla_username ? scylla_username : "";
+  cluster.password = scylla_password ? scylla_password : "";
+  scan_username = scylla_scan_username ? scylla_scan_username : "";
+  scan_password = scylla_scan_password ? scylla_scan_password : "";
+  bypass_cache = SCYLLA_BYPASS_CACHE_AUTO;
+  scan_rows_per_sec = 0;
+  scan_bytes_per_sec = 0;
+  write_rows_per_sec = 0;
+  write_bytes_per_sec = 0;
+  write_behind = 0;
+  duplicate_keys = SCYLLA_DUPLICATE_KEY_UPSERT;
+  
+  parse_comment(comment);
+  
+  // Use defaults if not specified
+  if (hosts.empty()) {
+    hosts = "127.0.0.1";
+  }
+  if (keyspace.empty()) {
+    keyspace = "mariadb";
+  }
+  
+  // Extract table name from the path if not specified
+  if (table.empty() && name) {
+    const char *table_ptr = strrchr(name, '/');
+    table = table_ptr ? table_ptr + 1 : name;
+  }
 }
 
 /**
  * Parse table comment for ScyllaDB connection parameters
  * Expected format: COMMENT='scylla_hosts=host1,host2;scylla_keyspace=ks;scylla_table=tbl'
  */
-int ha_scylla::parse_table_comment(const char *comment)
+void ScyllaTableOptions::parse_comment(const char *comment)
 {
-  DBUG_ENTER("ha_scylla::parse_table_comment");
-  
   if (!comment || !*comment) {
-    DBUG_RETURN(0);
+    return;
   }
   
   std::string comment_str(comment);
@@ -180,481 +988,2163 @@ int ha_scylla::parse_table_comment(const char *comment)
     value.erase(value.find_last_not_of(" \t\r\n") + 1);
     
     if (key == "scylla_hosts") {
-      scylla_hosts = value;
+      hosts = value;
     } else if (key == "scylla_keyspace") {
-      keyspace_name = value;
+      keyspace = value;
     } else if (key == "scylla_table") {
-      table_name = value;
+      table = value;
     } else if (key == "scylla_port") {
-      scylla_port = std::stoi(value);
+      port = atoi(value.c_str());
     } else if (key == "scylla_verbose") {
-      verbose_logging = (value == "true" || value == "1" || value == "yes");
+      verbose = (value == "true" || value == "1" || value == "yes");
+    } else if (key == "scylla_cache_ttl") {
+      cache_ttl = atol(value.c_str());
+    } else if (key == "scylla_read_consistency") {
+      read_consistency = ScyllaConnection::consistency_from_name(value);
+    } else if (key == "scylla_write_consistency") {
+      write_consistency = ScyllaConnection::consistency_from_name(value);
+    } else if (key == "scylla_serial_consistency") {
+      serial_consistency = ScyllaConnection::consistency_from_name(value);
+    } else if (key == "scylla_local_dc") {
+      cluster.local_dc = value;
+    } else if (key == "scylla_latency_aware") {
+      cluster.latency_aware = (value == "true" || value == "1" || value == "yes");
+    } else if (key == "scylla_scan_rows_per_sec") {
+      scan_rows_per_sec = strtoull(value.c_str(), NULL, 10);
+    } else if (key == "scylla_scan_bytes_per_sec") {
+      scan_bytes_per_sec = strtoull(value.c_str(), NULL, 10);
+    } else if (key == "scylla_write_rows_per_sec") {
+      write_rows_per_sec = strtoull(value.c_str(), NULL, 10);
+    } else if (key == "scylla_write_bytes_per_sec") {
+      write_bytes_per_sec = strtoull(value.c_str(), NULL, 10);
+    } else if (key == "scylla_write_behind") {
+      write_behind = (uint) strtoul(value.c_str(), NULL, 10);
+    } else if (key == "scylla_duplicate_keys") {
+      duplicate_keys = (value == "check") ? SCYLLA_DUPLICATE_KEY_CHECK
+                                          : SCYLLA_DUPLICATE_KEY_UPSERT;
+    } else if (key == "scylla_bypass_cache") {
+      if (value == "true" || value == "1" || value == "yes" || value == "on") {
+        bypass_cache = SCYLLA_BYPASS_CACHE_ON;
+      } else if (value == "auto") {
+        bypass_cache = SCYLLA_BYPASS_CACHE_AUTO;
+      } else {
+        bypass_cache = SCYLLA_BYPASS_CACHE_OFF;
+      }
+    } else if (key == "scylla_execution_profile") {
+      execution_profile = ScyllaClusterOptions::profile_from_name(value);
     }
   }
-  
-  DBUG_RETURN(0);
 }
 
 /**
- * Connect to ScyllaDB cluster
+ * Share constructor
  */
-int ha_scylla::connect_to_scylla()
+Scylla_share::Scylla_share()
+  : initialized(false),
+    rows_read(0),
+    rows_written(0),
+    rows_updated(0),
+    rows_deleted(0),
+    estimated_rows(0),
+    cache_epoch(0),
+    cdc_subscription(0)
 {
-  DBUG_ENTER("ha_scylla::connect_to_scylla");
+  thr_lock_init(&lock);
+}
+
+/**
+ * Share destructor
+ */
+Scylla_share::~Scylla_share()
+{
+  if (cdc) {
+    cdc->unsubscribe(cdc_subscription);
+  }
+  for (std::map<std::string, const CassPrepared*>::iterator it = prepared.begin();
+       it != prepared.end(); ++it) {
+    cass_prepared_free(it->second);
+  }
+  thr_lock_delete(&lock);
+}
+
+/**
+ * Parse options, connect and load the table schema
+ */
+int Scylla_share::init(TABLE *table, const char *name)
+{
+  DBUG_ENTER("Scylla_share::init");
   
-  if (conn && conn->is_connected()) {
+  if (initialized) {
     DBUG_RETURN(0);
   }
   
-  try {
-    conn = std::make_shared<ScyllaConnection>();
-    
-    if (scylla_hosts.empty()) {
-      scylla_hosts = "127.0.0.1";
-    }
-    
-    if (!conn->connect(scylla_hosts, scylla_port)) {
-      my_printf_error(ER_CONNECT_TO_FOREIGN_DATA_SOURCE,
-                      "Cannot connect to ScyllaDB cluster at %s:%d",
-                      MYF(0), scylla_hosts.c_str(), scylla_port);
-      DBUG_RETURN(HA_ERR_NO_CONNECTION);
+  options.init(table->s->comment.str, name);
+  
+  conn = ScyllaConnectionPool::acquire(options.hosts, options.port, options.cluster);
+  if (!conn) {
+    my_printf_error(ER_CONNECT_TO_FOREIGN_DATA_SOURCE,
+                    "Cannot connect to ScyllaDB cluster at %s:%d",
+                    MYF(0), options.hosts.c_str(), options.port);
+    DBUG_RETURN(HA_ERR_NO_CONNECTION);
+  }
+  
+  qualified_name = options.keyspace + "." + options.table;
+  cache_epoch = ++scylla_cache_epochs;
+  
+  ScyllaQueryBuilder builder;
+  column_list = builder.build_column_list(table);
+  select_all_cql = builder.build_select_cql(table, options.keyspace, options.table, true);
+  select_all_bypass_cql = select_all_cql + " BYPASS CACHE";
+  insert_template = builder.build_insert_template(table, options.keyspace, options.table);
+  delete_template = builder.build_delete_template(table, options.keyspace, options.table);
+  
+  load_schema(table);
+  
+  // Bind markers of the INSERT holding the partition key, whose values
+  // give the token of a row
+  partition_key_params.clear();
+  for (size_t k = 0; k < partition_key.size(); k++) {
+    size_t param = 0;
+    while (param < insert_template.fields.size() &&
+           strcasecmp(table->field[insert_template.fields[param]]->field_name.str,
+                      partition_key[k].c_str()) != 0) {
+      param++;
     }
-    
-    if (verbose_logging && global_system_variables.log_warnings >= 3) {
-      sql_print_information("Scylla: Table %s.%s: Successfully created connection to remote server %s:%d",
-                           keyspace_name.c_str(), table_name.c_str(),
-                           scylla_hosts.c_str(), scylla_port);
+    if (param == insert_template.fields.size()) {
+      partition_key_params.clear();
+      break;
     }
-    
-    if (!keyspace_name.empty()) {
-      conn->use_keyspace(keyspace_name);
+    partition_key_params.push_back(param);
+  }
+  
+  // Follow changes made by other clients while rows of the table may be cached
+  if (scylla_cdc_invalidation && options.cache_ttl != 0 && table->s->primary_key != MAX_KEY) {
+    cdc = ScyllaConnectionPool::cdc_consumer(options.hosts, options.port, options.cluster,
+                                             scylla_cdc_poll_interval);
+    if (cdc) {
+      std::vector<std::string> key_columns(partition_key);
+      key_columns.insert(key_columns.end(), clustering_key.begin(), clustering_key.end());
+      cdc_subscription = cdc->subscribe(options.keyspace, options.table, key_columns,
+        [this](const std::vector<std::vector<std::string>> &keys) {
+          invalidate_changed_rows(keys);
+        });
     }
   }
-  catch (const std::exception &e) {
-    my_printf_error(ER_CONNECT_TO_FOREIGN_DATA_SOURCE,
-                    "ScyllaDB connection error: %s", MYF(0), e.what());
-    DBUG_RETURN(HA_ERR_NO_CONNECTION);
+  
+  if (options.verbose && global_system_variables.log_warnings >= 3) {
+    sql_print_information("Scylla: Table %s: Opened share on %s:%d, %zu partition key "
+                         "and %zu clustering columns, %zu indexes",
+                         qualified_name.c_str(), options.hosts.c_str(), options.port,
+                         partition_key.size(), clustering_key.size(), indexes.size());
   }
   
+  initialized = true;
   DBUG_RETURN(0);
 }
 
 /**
- * Execute CQL query
+ * Load partition key, clustering key and indexes from system_schema.
+ * Falls back to the MariaDB primary key (first part as partition key, the
+ * rest as clustering columns, as created by build_create_table_cql())
  */
-int ha_scylla::execute_cql(const std::string &cql)
+int Scylla_share::load_schema(TABLE *table)
 {
-  DBUG_ENTER("ha_scylla::execute_cql");
-  
+  DBUG_ENTER("Scylla_share::load_schema");
+  
+  partition_key.clear();
+  clustering_key.clear();
+  indexes.clear();
+  
+  std::string where = " WHERE keyspace_name = '" + ScyllaTypes::escape_string(options.keyspace) +
+                      "' AND table_name = '" + ScyllaTypes::escape_string(options.table) + "'";
+  
+  std::vector<std::string> names;
+  std::vector<std::vector<std::string>> rows;
+  
+  if (conn->execute("SELECT column_name, kind, position FROM system_schema.columns" + where,
+                    names, rows)) {
+    std::map<int, std::string> pk_by_pos, ck_by_pos;
+    for (size_t i = 0; i < rows.size(); i++) {
+      if (rows[i].size() < 3) continue;
+      if (rows[i][1] == "partition_key") {
+        pk_by_pos[atoi(rows[i][2].c_str())] = rows[i][0];
+      } else if (rows[i][1] == "clustering") {
+        ck_by_pos[atoi(rows[i][2].c_str())] = rows[i][0];
+      }
+    }
+    for (std::map<int, std::string>::iterator it = pk_by_pos.begin(); it != pk_by_pos.end(); ++it) {
+      partition_key.push_back(it->second);
+    }
+    for (std::map<int, std::string>::iterator it = ck_by_pos.begin(); it != ck_by_pos.end(); ++it) {
+      clustering_key.push_back(it->second);
+    }
+  }
+  
+  if (conn->execute("SELECT index_name FROM system_schema.indexes" + where, names, rows)) {
+    for (size_t i = 0; i < rows.size(); i++) {
+      if (!rows[i].empty()) {
+        indexes.push_back(rows[i][0]);
+      }
+    }
+  }
+  
+  if (partition_key.empty()) {
+    if (table->s->primary_key != MAX_KEY) {
+      KEY *key_info = &table->key_info[table->s->primary_key];
+      for (uint i = 0; i < key_info->user_defined_key_parts; i++) {
+        std::string col(key_info->key_part[i].field->field_name.str);
+        if (i == 0) {
+          partition_key.push_back(col);
+        } else {
+          clustering_key.push_back(col);
+        }
+      }
+    } else if (table->s->fields > 0) {
+      partition_key.push_back(table->field[0]->field_name.str);
+    }
+  }
+  
+  DBUG_RETURN(0);
+}
+
+/**
+ * Get a prepared statement, preparing it on first use
+ */
+const CassPrepared* Scylla_share::get_prepared(const std::string &cql, size_t param_count)
+{
+  {
+    std::lock_guard<std::mutex> guard(prepared_mutex);
+    std::map<std::string, const CassPrepared*>::iterator it = prepared.find(cql);
+    if (it != prepared.end()) {
+      return it->second;
+    }
+  }
+  
+  // Prepare outside the lock; a concurrent duplicate is simply dropped
+  const CassPrepared *stmt = conn ? conn->prepare(cql) : nullptr;
+  
+  for (size_t i = 0; stmt && i < param_count; i++) {
+    const CassDataType *type = cass_prepared_parameter_data_type(stmt, i);
+    if (!type || !ScyllaTypes::can_bind(cass_data_type_type(type))) {
+      cass_prepared_free(stmt);
+      stmt = nullptr;
+    }
+  }
+  
+  if (!stmt && options.verbose && global_system_variables.log_warnings >= 3) {
+    sql_print_information("Scylla: Table %s: Using CQL literals, cannot prepare %s",
+                         qualified_name.c_str(), cql.c_str());
+  }
+  
+  // Failures are cached as well so every row does not retry them
+  std::lock_guard<std::mutex> guard(prepared_mutex);
+  std::pair<std::map<std::string, const CassPrepared*>::iterator, bool> res =
+    prepared.insert(std::make_pair(cql, stmt));
+  if (!res.second && stmt) {
+    cass_prepared_free(stmt);
+  }
+  
+  return res.first->second;
+}
+
+/**
+ * Build the row cache key of a primary key value
+ */
+std::string Scylla_share::cache_key(const uchar *key, uint length) const
+{
+  std::string result = qualified_name;
+  result += '\0';
+  result += std::to_string(cache_epoch.load());
+  result += '\0';
+  result.append(reinterpret_cast<const char*>(key), length);
+  return result;
+}
+
+/**
+ * Build the row cache tag of a lookup result
+ */
+std::string Scylla_share::cache_tag(const std::vector<std::string> &column_names,
+                                    const std::vector<std::string> *row) const
+{
+  std::string tag = qualified_name;
+  tag += '\0';
+  if (!row) {
+    return tag;
+  }
+  
+  std::vector<std::string> key_columns(partition_key);
+  key_columns.insert(key_columns.end(), clustering_key.begin(), clustering_key.end());
+  
+  for (size_t k = 0; k < key_columns.size(); k++) {
+    size_t i = 0;
+    while (i < column_names.size() &&
+           strcasecmp(column_names[i].c_str(), key_columns[k].c_str()) != 0) {
+      i++;
+    }
+    if (i >= column_names.size() || i >= row->size()) {
+      return std::string();
+    }
+    if (k > 0) {
+      tag += '\0';
+    }
+    tag += (*row)[i];
+  }
+  
+  return tag;
+}
+
+/**
+ * Drop cached rows changed by other clients, as reported by CDC
+ */
+void Scylla_share::invalidate_changed_rows(const std::vector<std::vector<std::string>> &keys)
+{
+  std::vector<std::string> tags;
+  
+  // Any change may create a row that was cached as missing
+  tags.push_back(qualified_name + '\0');
+  
+  for (size_t i = 0; i < keys.size(); i++) {
+    std::string tag = qualified_name;
+    tag += '\0';
+    for (size_t k = 0; k < keys[i].size(); k++) {
+      // Partition and range deletions leave clustering columns unset;
+      // they cannot be matched to rows, so drop the whole table
+      if (keys[i][k] == "NULL") {
+        cache_epoch = ++scylla_cache_epochs;
+        return;
+      }
+      if (k > 0) {
+        tag += '\0';
+      }
+      tag += keys[i][k];
+    }
+    tags.push_back(tag);
+  }
+  
+  scylla_row_cache.invalidate_tags(tags);
+}
+
+/**
+ * Get the UPDATE template for the set of written fields
+ */
+const ScyllaStatementTemplate &Scylla_share::get_update_template(TABLE *table,
+                                                                 const MY_BITMAP *write_set)
+{
+  std::string key("U");
+  key.append(reinterpret_cast<const char*>(write_set->bitmap), no_bytes_in_map(write_set));
+  
+  std::lock_guard<std::mutex> guard(templates_mutex);
+  std::map<std::string, ScyllaStatementTemplate>::iterator it = templates.find(key);
+  if (it == templates.end()) {
+    ScyllaQueryBuilder builder;
+    it = templates.insert(std::make_pair(key,
+           builder.build_update_template(table, write_set, options.keyspace, options.table))).first;
+  }
+  
+  return it->second;
+}
+
+/**
+ * Get the SELECT template for a prefix of an index
+ */
+const ScyllaStatementTemplate &Scylla_share::get_lookup_template(TABLE *table, uint index,
+                                                                 uint key_parts)
+{
+  std::string key = "L" + std::to_string(index) + ":" + std::to_string(key_parts);
+  
+  std::lock_guard<std::mutex> guard(templates_mutex);
+  std::map<std::string, ScyllaStatementTemplate>::iterator it = templates.find(key);
+  if (it == templates.end()) {
+    ScyllaQueryBuilder builder;
+    it = templates.insert(std::make_pair(key,
+           builder.build_key_lookup_template(table, index, key_parts,
+                                             options.keyspace, options.table))).first;
+  }
+  
+  return it->second;
+}
+
+/**
+ * Constructor
+ */
+ha_scylla::ha_scylla(handlerton *hton, TABLE_SHARE *table_arg)
+  : handler(hton, table_arg),
+    share(NULL),
+    options(&ddl_options),
+    current_position(0),
+    scan_active(false),
+    accounted_memory(0),
+    accounted_thd(NULL),
+    hints_query_id(0),
+    hint_consistency(CASS_CONSISTENCY_UNKNOWN),
+    hint_serial_consistency(CASS_CONSISTENCY_UNKNOWN),
+    bulk_concurrency(0),
+    bulk_batch_rows(0),
+    bulk_delete(false),
+    write_can_replace(false)
+{
+}
+
+/**
+ * Destructor
+ */
+ha_scylla::~ha_scylla()
+{
+  close_write_behind();
+}
+
+/**
+ * Get or create the share of the table
+ */
+Scylla_share *ha_scylla::get_share()
+{
+  Scylla_share *tmp_share;
+  
+  DBUG_ENTER("ha_scylla::get_share");
+  
+  lock_shared_ha_data();
+  if (!(tmp_share = static_cast<Scylla_share*>(get_ha_share_ptr()))) {
+    tmp_share = new Scylla_share;
+    set_ha_share_ptr(static_cast<Handler_share*>(tmp_share));
+  }
+  unlock_shared_ha_data();
+  
+  DBUG_RETURN(tmp_share);
+}
+
+/**
+ * Connect to ScyllaDB cluster
+ */
+int ha_scylla::connect_to_scylla()
+{
+  DBUG_ENTER("ha_scylla::connect_to_scylla");
+  
+  if (conn && conn->is_connected()) {
+    DBUG_RETURN(0);
+  }
+  
+  try {
+    conn = ScyllaConnectionPool::acquire(options->hosts, options->port, options->cluster);
+    
+    if (!conn) {
+      my_printf_error(ER_CONNECT_TO_FOREIGN_DATA_SOURCE,
+                      "Cannot connect to ScyllaDB cluster at %s:%d",
+                      MYF(0), options->hosts.c_str(), options->port);
+      DBUG_RETURN(HA_ERR_NO_CONNECTION);
+    }
+    
+    if (options->verbose && global_system_variables.log_warnings >= 3) {
+      sql_print_information("Scylla: Table %s.%s: Successfully created connection to remote server %s:%d",
+                           options->keyspace.c_str(), options->table.c_str(),
+                           options->hosts.c_str(), options->port);
+    }
+  }
+  catch (const std::exception &e) {
+    my_printf_error(ER_CONNECT_TO_FOREIGN_DATA_SOURCE,
+                    "ScyllaDB connection error: %s", MYF(0), e.what());
+    DBUG_RETURN(HA_ERR_NO_CONNECTION);
+  }
+  
+  DBUG_RETURN(0);
+}
+
+/**
+ * Whether a full scan should skip ScyllaDB's row cache: the session
+ * setting, then the table's, then the row count seen by the last scan
+ */
+bool ha_scylla::scan_bypasses_cache()
+{
+  ulong mode = THDVAR(ha_thd(), bypass_cache);
+  if (mode == SCYLLA_BYPASS_CACHE_AUTO) {
+    mode = options->bypass_cache;
+  }
+  
+  if (mode == SCYLLA_BYPASS_CACHE_AUTO) {
+    return scylla_bypass_cache_rows > 0 &&
+           (ulonglong) share->estimated_rows >= scylla_bypass_cache_rows;
+  }
+  
+  return mode == SCYLLA_BYPASS_CACHE_ON;
+}
+
+/**
+ * Wait until the global and table scan rate limits admit one more row
+ * @return false if the statement was interrupted while waiting
+ */
+bool ha_scylla::throttle_scan(ulonglong bytes)
+{
+  uint64_t waited_us = 0;
+  bool ok = scylla_scan_rows_limiter.acquire(1, (double) scylla_scan_rows_per_sec, &waited_us) &&
+            scylla_scan_bytes_limiter.acquire((double) bytes, (double) scylla_scan_bytes_per_sec,
+                                              &waited_us) &&
+            share->scan_rows_limiter.acquire(1, (double) options->scan_rows_per_sec,
+                                             &waited_us) &&
+            share->scan_bytes_limiter.acquire((double) bytes, (double) options->scan_bytes_per_sec,
+                                              &waited_us);
+  if (waited_us) {
+    scylla_scan_throttled_us += waited_us;
+  }
+  return ok;
+}
+
+/**
+ * Wait until the global and table write rate limits admit one more row
+ * @return false if the statement was interrupted while waiting
+ */
+bool ha_scylla::throttle_write(ulonglong bytes)
+{
+  uint64_t waited_us = 0;
+  bool ok = scylla_write_rows_limiter.acquire(1, (double) scylla_write_rows_per_sec, &waited_us) &&
+            scylla_write_bytes_limiter.acquire((double) bytes, (double) scylla_write_bytes_per_sec,
+                                               &waited_us) &&
+            share->write_rows_limiter.acquire(1, (double) options->write_rows_per_sec,
+                                              &waited_us) &&
+            share->write_bytes_limiter.acquire((double) bytes, (double) options->write_bytes_per_sec,
+                                               &waited_us);
+  if (waited_us) {
+    scylla_write_throttled_us += waited_us;
+  }
+  return ok;
+}
+
+/**
+ * Retries of failed writes; writes are only retried when they carry client
+ * timestamps
+ */
+ScyllaRetryPolicy ha_scylla::write_retry_policy() const
+{
+  ScyllaRetryPolicy retry;
+  if (options->cluster.client_timestamps) {
+    retry.max_retries = scylla_write_retries;
+    retry.backoff_ms = scylla_retry_backoff;
+    retry.max_backoff_ms = std::max(scylla_retry_backoff, scylla_retry_backoff_max);
+  }
+  return retry;
+}
+
+/**
+ * Quote a CQL name, doubling embedded quotes
+ */
+static std::string quote_cql_name(const std::string &name, char quote)
+{
+  std::string quoted(1, quote);
+  for (char c : name) {
+    if (c == quote) {
+      quoted += quote;
+    }
+    quoted += c;
+  }
+  quoted += quote;
+  return quoted;
+}
+
+/**
+ * Create the scan service level with scylla_scan_shares and attach it to
+ * the scan role, once per cluster. Needs a main role allowed to manage
+ * service levels; failures are logged and the scan session is used anyway.
+ */
+static void setup_scan_service_level(ScyllaConnection *admin_conn,
+                                     const ScyllaTableOptions &options)
+{
+  if (scylla_scan_shares == 0 || !scylla_scan_service_level || !*scylla_scan_service_level) {
+    return;
+  }
+  
+  std::string cluster_key = options.hosts + ":" + std::to_string(options.port);
+  {
+    std::lock_guard<std::mutex> lock(scylla_service_levels_mutex);
+    if (!scylla_service_levels.insert(cluster_key).second) {
+      return;
+    }
+  }
+  
+  std::string level = quote_cql_name(scylla_scan_service_level, '"');
+  std::string shares = std::to_string(scylla_scan_shares);
+  const std::string statements[] = {
+    "CREATE SERVICE LEVEL IF NOT EXISTS " + level + " WITH shares = " + shares,
+    "ALTER SERVICE LEVEL " + level + " WITH shares = " + shares,
+    "ATTACH SERVICE LEVEL " + level + " TO " + quote_cql_name(options.scan_username, '\'')
+  };
+  
+  for (const std::string &cql : statements) {
+    if (!admin_conn->execute(cql)) {
+      sql_print_warning("Scylla: Cannot set up service level %s on %s (%s); "
+                        "scans run with the scan role's current service level",
+                        scylla_scan_service_level, cluster_key.c_str(), cql.c_str());
+      return;
+    }
+  }
+  
+  sql_print_information("Scylla: Scans on %s run as %s with service level %s (%u shares)",
+                        cluster_key.c_str(), options.scan_username.c_str(),
+                        scylla_scan_service_level, scylla_scan_shares);
+}
+
+/**
+ * Session a workload runs in: scans and bulk writes use the scan role's
+ * session when scylla_scan_username is set, everything else the table's
+ * @return Connected session, or NULL after reporting the error
+ */
+const std::shared_ptr<ScyllaConnection> &
+ha_scylla::workload_connection(ScyllaClusterOptions::Profile profile)
+{
+  if (profile == ScyllaClusterOptions::PROFILE_OLTP || options->scan_username.empty()) {
+    return conn;
+  }
+  
+  if (scan_conn && scan_conn->is_connected()) {
+    return scan_conn;
+  }
+  
+  ScyllaClusterOptions scan_options = options->cluster;
+  scan_options.username = options->scan_username;
+  scan_options.password = options->scan_password;
+  
+  scan_conn = ScyllaConnectionPool::acquire(options->hosts, options->port, scan_options);
+  if (!scan_conn) {
+    my_printf_error(ER_CONNECT_TO_FOREIGN_DATA_SOURCE,
+                    "Cannot connect to ScyllaDB cluster at %s:%d as %s",
+                    MYF(0), options->hosts.c_str(), options->port,
+                    options->scan_username.c_str());
+    return scan_conn;
+  }
+  
+  if (conn) {
+    setup_scan_service_level(conn.get(), *options);
+  }
+  
+  return scan_conn;
+}
+
+/**
+ * Bind the fields of a row buffer to the prepared form of a template.
+ * The key condition is bound from key_buf when given (UPDATE binds the new
+ * values but must address the old row)
+ * @return New statement, or NULL if the template cannot be prepared or bound
+ */
+CassStatement *ha_scylla::bind_template(const ScyllaStatementTemplate &tpl, const uchar *buf,
+                                        const uchar *key_buf)
+{
+  const CassPrepared *prepared = share->get_prepared(tpl.cql, tpl.fields.size());
+  if (!prepared) {
+    return NULL;
+  }
+  
+  CassStatement *statement = cass_prepared_bind(prepared);
+  
+  MY_BITMAP *org_bitmap = dbug_tmp_use_all_columns(table, &table->read_set);
+  
+  for (size_t i = 0; i < tpl.fields.size(); i++) {
+    Field *field = table->field[tpl.fields[i]];
+    const uchar *source = (key_buf && i >= tpl.key_start) ? key_buf : buf;
+    my_ptrdiff_t offset = source - table->record[0];
+    CassValueType type = cass_data_type_type(cass_prepared_parameter_data_type(prepared, i));
+    
+    field->move_field_offset(offset);
+    bool bound = ScyllaTypes::bind_field_value(statement, i, field, type);
+    field->move_field_offset(-offset);
+    
+    if (!bound) {
+      cass_statement_free(statement);
+      statement = NULL;
+      break;
+    }
+  }
+  
+  dbug_tmp_restore_column_map(&table->read_set, org_bitmap);
+  
+  return statement;
+}
+
+/**
+ * Find "name=VALUE" inside the comments of a query
+ * @return Consistency level, CASS_CONSISTENCY_UNKNOWN if absent or invalid
+ */
+static CassConsistency find_consistency_hint(const char *query, size_t length,
+                                             const char *name)
+{
+  std::string text(query, length);
+  std::string key = std::string(name) + "=";
+  
+  for (size_t start = text.find("/*"); start != std::string::npos;
+       start = text.find("/*", start + 2)) {
+    size_t end = text.find("*/", start + 2);
+    if (end == std::string::npos) {
+      break;
+    }
+    
+    size_t pos = text.find(key, start);
+    if (pos != std::string::npos && pos < end) {
+      size_t value_start = pos + key.length();
+      size_t value_end = text.find_first_not_of("ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+                                                "abcdefghijklmnopqrstuvwxyz_",
+                                                value_start);
+      return ScyllaConnection::consistency_from_name(
+        text.substr(value_start, std::min(value_end, end) - value_start));
+    }
+  }
+  
+  return CASS_CONSISTENCY_UNKNOWN;
+}
+
+/**
+ * Consistency level of a statement. The first that is set wins: a hint in
+ * a comment of the query, the session variable, the table option, the
+ * driver default (CASS_CONSISTENCY_UNKNOWN)
+ */
+CassConsistency ha_scylla::statement_consistency(bool write)
+{
+  THD *thd = ha_thd();
+  
+  // Hints are parsed once per query
+  if (hints_query_id != thd->query_id) {
+    hints_query_id = thd->query_id;
+    hint_consistency = CASS_CONSISTENCY_UNKNOWN;
+    hint_serial_consistency = CASS_CONSISTENCY_UNKNOWN;
+    if (thd->query() && strstr(thd->query(), "scylla_")) {
+      hint_consistency = find_consistency_hint(thd->query(), thd->query_length(),
+                                               "scylla_consistency");
+      hint_serial_consistency = find_consistency_hint(thd->query(), thd->query_length(),
+                                                      "scylla_serial_consistency");
+    }
+  }
+  
+  CassConsistency consistency = hint_consistency;
+  if (consistency == CASS_CONSISTENCY_UNKNOWN) {
+    consistency = scylla_consistency_levels[write ? THDVAR(thd, write_consistency)
+                                                  : THDVAR(thd, read_consistency)];
+  }
+  if (consistency == CASS_CONSISTENCY_UNKNOWN) {
+    consistency = write ? options->write_consistency : options->read_consistency;
+  }
+  
+  return consistency;
+}
+
+/**
+ * Set the consistency of a statement (see statement_consistency()) and
+ * its serial consistency, chosen the same way
+ */
+void ha_scylla::apply_consistency(CassStatement *statement, bool write)
+{
+  THD *thd = ha_thd();
+  
+  CassConsistency consistency = statement_consistency(write);
+  if (consistency != CASS_CONSISTENCY_UNKNOWN) {
+    cass_statement_set_consistency(statement, consistency);
+  }
+  
+  CassConsistency serial = hint_serial_consistency;
+  if (serial == CASS_CONSISTENCY_UNKNOWN) {
+    serial = scylla_serial_consistency_levels[THDVAR(thd, serial_consistency)];
+  }
+  if (serial == CASS_CONSISTENCY_UNKNOWN) {
+    serial = options->serial_consistency;
+  }
+  if (serial == CASS_CONSISTENCY_SERIAL || serial == CASS_CONSISTENCY_LOCAL_SERIAL) {
+    cass_statement_set_serial_consistency(statement, serial);
+  }
+}
+
+/**
+ * Check the statement is still running, then apply the per-statement
+ * settings: execution profile, consistency, idempotence, and a request
+ * timeout of the time left before max_statement_time
+ * @param statement Statement about to be executed
+ * @param write Whether the statement writes (selects the consistency)
+ * @param profile Execution profile of the statement type, PROFILE_COUNT
+ *        for none (schema changes keep the connection's request timeout)
+ * @param row_write Whether the statement inserts, updates or deletes a row
+ * @return 0, or HA_ERR_ABORTED_BY_USER if the statement was killed
+ */
+int ha_scylla::prepare_statement(CassStatement *statement, bool write,
+                                 ScyllaClusterOptions::Profile profile, bool row_write)
+{
+  THD *thd = ha_thd();
+  if (scylla_statement_interrupted(thd)) {
+    return HA_ERR_ABORTED_BY_USER;
+  }
+  
+  // A profile named in the table comment overrides the statement type
+  if (profile != ScyllaClusterOptions::PROFILE_COUNT &&
+      options->execution_profile != ScyllaClusterOptions::PROFILE_COUNT) {
+    profile = options->execution_profile;
+  }
+  if (profile != ScyllaClusterOptions::PROFILE_COUNT) {
+    cass_statement_set_execution_profile(statement, ScyllaClusterOptions::profile_name(profile));
+  }
+  
+  apply_consistency(statement, write);
+  
+  // Idempotent statements may be hedged by speculative execution and are
+  // retried by the driver. The engine's row writes are plain upserts and
+  // deletes, so they are idempotent once they carry a client timestamp
+  // pinned by pin_write_timestamp(): a replayed write cannot overwrite a
+  // later one. The engine retries those itself with backoff, so the
+  // driver must not retry them again. Schema changes are never idempotent
+  if (!write) {
+    cass_statement_set_is_idempotent(statement, cass_true);
+  } else if (row_write && options->cluster.client_timestamps) {
+    cass_statement_set_is_idempotent(statement, cass_true);
+    cass_statement_set_retry_policy(statement, ScyllaRetryPolicy::driver_policy());
+  }
+  
+  apply_statement_deadline(statement, profile);
+  return 0;
+}
+
+/**
+ * Give a row write its client timestamp once, before its first attempt, so
+ * every retry carries the same one and cannot overwrite writes issued after
+ * it (the driver would stamp each attempt anew)
+ * @param statement Row write
+ * @return The timestamp, 0 without client timestamps
+ */
+int64_t ha_scylla::pin_write_timestamp(CassStatement *statement)
+{
+  if (!options->cluster.client_timestamps) {
+    return 0;
+  }
+  int64_t timestamp = ScyllaConnection::next_timestamp();
+  cass_statement_set_timestamp(statement, timestamp);
+  return timestamp;
+}
+
+/**
+ * Limit the request timeout to the time left before max_statement_time.
+ * The server's own timer kills the statement at the deadline; the request
+ * timeout keeps the driver from waiting on past it
+ * @param statement Statement about to be executed
+ * @param profile Execution profile the statement runs under, PROFILE_COUNT
+ *        for none
+ */
+void ha_scylla::apply_statement_deadline(CassStatement *statement,
+                                         ScyllaClusterOptions::Profile profile)
+{
+  THD *thd = ha_thd();
+  ulonglong limit_us = thd->variables.max_statement_time;
+  if (limit_us == 0) {
+    return;
+  }
+  
+  ulonglong elapsed_us = microsecond_interval_timer() - thd->start_utime;
+  ulonglong left_ms = elapsed_us < limit_us ? (limit_us - elapsed_us + 999) / 1000 : 1;
+  
+  // A statement timeout replaces the profile's, so only set a shorter one
+  unsigned int profile_ms = profile != ScyllaClusterOptions::PROFILE_COUNT
+                              ? options->cluster.profiles[profile].request_timeout_ms : 0;
+  if (profile_ms == 0 || left_ms < profile_ms) {
+    cass_statement_set_request_timeout(statement, left_ms);
+  }
+}
+
+/**
+ * Token of the partition a row belongs to
+ * @return false if the partition key cannot be serialized
+ */
+bool ha_scylla::partition_token(const uchar *row, int64_t *token)
+{
+  const ScyllaStatementTemplate &tpl = share->insert_template;
+  if (share->partition_key_params.empty()) {
+    return false;
+  }
+  const CassPrepared *prepared = share->get_prepared(tpl.cql, tpl.fields.size());
+  if (!prepared) {
+    return false;
+  }
+  
+  std::vector<std::string> components(share->partition_key_params.size());
+  my_ptrdiff_t offset = row - table->record[0];
+  bool ok = true;
+  
+  MY_BITMAP *org_bitmap = dbug_tmp_use_all_columns(table, &table->read_set);
+  
+  for (size_t i = 0; ok && i < components.size(); i++) {
+    size_t param = share->partition_key_params[i];
+    Field *field = table->field[tpl.fields[param]];
+    CassValueType type = cass_data_type_type(cass_prepared_parameter_data_type(prepared, param));
+    
+    field->move_field_offset(offset);
+    ok = ScyllaTypes::serialize_field_value(field, type, components[i]);
+    field->move_field_offset(-offset);
+  }
+  
+  dbug_tmp_restore_column_map(&table->read_set, org_bitmap);
+  
+  if (ok) {
+    *token = ScyllaPartitioner::token(components);
+  }
+  return ok;
+}
+
+/**
+ * Execute CQL query, or the statement bound for it (which is freed here).
+ * Only writes of a row are retried; with scylla_write_coalescing they go
+ * through the cluster's write coalescer.
+ */
+int ha_scylla::execute_cql(const std::string &cql, CassStatement *statement,
+                           const uchar *row)
+{
+  DBUG_ENTER("ha_scylla::execute_cql");
+  
+  // The statement only lives for this call
+  std::unique_ptr<CassStatement, void (*)(CassStatement*)>
+    statement_guard(statement, [](CassStatement *stmt) { if (stmt) cass_statement_free(stmt); });
+  
+  int rc = connect_to_scylla();
+  if (rc) {
+    DBUG_RETURN(rc);
+  }
+  
+  if (!statement) {
+    statement = cass_statement_new(cql.c_str(), 0);
+    statement_guard.reset(statement);
+  }
+  
+  // Schema changes are not idempotent and run once
+  ScyllaRetryPolicy retry = row ? write_retry_policy() : ScyllaRetryPolicy();
+  int64_t timestamp = row ? pin_write_timestamp(statement) : 0;
+  
+  int64_t token = 0;
+  bool coalesce = scylla_write_coalescing && row && partition_token(row, &token);
+  ScyllaClusterOptions::Profile profile =
+    options->execution_profile != ScyllaClusterOptions::PROFILE_COUNT
+      ? options->execution_profile : ScyllaClusterOptions::PROFILE_OLTP;
+  
+  try {
+    for (unsigned int attempt = 0;; attempt++) {
+      // Again before a retry, for the time left before max_statement_time
+      // Schema changes wait for schema agreement, far longer than the oltp
+      // profile allows; they run with the connection's request timeout
+      rc = prepare_statement(statement, true,
+                             row ? ScyllaClusterOptions::PROFILE_OLTP
+                                 : ScyllaClusterOptions::PROFILE_COUNT,
+                             row != NULL);
+      if (rc) {
+        DBUG_RETURN(rc);
+      }
+      
+      // A retry is sent alone: a coalesced batch would stamp it anew
+      CassError error;
+      std::string message;
+      if (coalesce && attempt == 0) {
+        ScyllaWriteCoalescer::Write write;
+        write.statement = statement;
+        write.token = token;
+        write.bytes = table->s->reclength;
+        write.consistency = statement_consistency(true);
+        write.profile = ScyllaClusterOptions::profile_name(profile);
+        write.idempotent = options->cluster.client_timestamps;
+        write.timestamp = timestamp;
+        error = conn->write_coalescer.write(write, scylla_write_coalesce_window,
+                                            scylla_write_coalesce_batch,
+                                            BULK_BATCH_MAX_BYTES, &message);
+      } else {
+        ScyllaFuture future = conn->execute_async(statement);
+        error = future.error_code();
+        if (error != CASS_OK) {
+          message = future.error_message();
+        }
+      }
+      if (error == CASS_OK) {
+        break;
+      }
+      
+      if (scylla_statement_interrupted(ha_thd())) {
+        DBUG_RETURN(HA_ERR_ABORTED_BY_USER);
+      }
+      
+      if (!retry.should_retry(error, attempt)) {
+        my_printf_error(ER_GET_ERRNO, "CQL execution failed: %s (%s)",
+                        MYF(0), cql.c_str(), message.c_str());
+        DBUG_RETURN(HA_ERR_GENERIC);
+      }
+      
+      if (options->verbose && global_system_variables.log_warnings >= 3) {
+        sql_print_information("Scylla: Table %s.%s: Retrying after %s",
+                             options->keyspace.c_str(), options->table.c_str(),
+                             message.c_str());
+      }
+      
+      ScyllaRetryPolicy::retries++;
+      if (!ScyllaWait::sleep(retry.backoff_us(attempt))) {
+        DBUG_RETURN(HA_ERR_ABORTED_BY_USER);
+      }
+    }
+  }
+  catch (const std::exception &e) {
+    my_printf_error(ER_GET_ERRNO, "CQL execution error: %s", MYF(0), e.what());
+    DBUG_RETURN(HA_ERR_GENERIC);
+  }
+  
+  DBUG_RETURN(0);
+}
+
+/**
+ * Execute CQL SELECT, or the statement bound for it (which is freed here),
+ * buffering all result pages into result_set
+ */
+int ha_scylla::execute_select(const std::string &cql, CassStatement *statement,
+                              ScyllaClusterOptions::Profile profile)
+{
+  DBUG_ENTER("ha_scylla::execute_select");
+  
+  // The statement only lives for this call
+  std::unique_ptr<CassStatement, void (*)(CassStatement*)>
+    statement_guard(statement, [](CassStatement *stmt) { if (stmt) cass_statement_free(stmt); });
+  
+  int rc = connect_to_scylla();
+  if (rc) {
+    DBUG_RETURN(rc);
+  }
+  
+  if (!statement) {
+    statement = cass_statement_new(cql.c_str(), 0);
+    statement_guard.reset(statement);
+  }
+  
+  rc = prepare_statement(statement, false, profile);
+  if (rc) {
+    DBUG_RETURN(rc);
+  }
+  
+  THD *thd = ha_thd();
+  release_result_memory();
+  result_set.reset(THDVAR(thd, spill_threshold), mysql_tmpdir);
+  
+  try {
+    bool spill_failed = false;
+    int limit_rc = 0;
+    // Throttling a scan delays fetching its next page
+    bool throttled = profile == ScyllaClusterOptions::PROFILE_SCAN &&
+                     (scylla_scan_rows_per_sec || scylla_scan_bytes_per_sec ||
+                      options->scan_rows_per_sec || options->scan_bytes_per_sec);
+    ScyllaConnection::RowCallback on_row =
+      [this, &spill_failed, &limit_rc, throttled](std::vector<std::string> &row) {
+        ulonglong bytes = 0;
+        if (throttled) {
+          for (const std::string &value : row) {
+            bytes += value.size();
+          }
+        }
+        if (!result_set.append(row)) {
+          spill_failed = true;
+          return false;
+        }
+        limit_rc = account_result_memory(false);
+        return limit_rc == 0 && (!throttled || throttle_scan(bytes));
+      };
+    const std::shared_ptr<ScyllaConnection> &select_conn = workload_connection(profile);
+    if (!select_conn) {
+      result_set.reset();
+      DBUG_RETURN(HA_ERR_NO_CONNECTION);
+    }
+    // Every further page only gets the time left of the statement
+    if (options->execution_profile != ScyllaClusterOptions::PROFILE_COUNT) {
+      profile = options->execution_profile;
+    }
+    ScyllaConnection::PageCallback before_page = [this, profile](CassStatement *stmt) {
+      apply_statement_deadline(stmt, profile);
+    };
+    bool ok = select_conn->execute_paged(statement, column_names, on_row, scylla_page_size,
+                                         before_page);
+    
+    if (spill_failed) {
+      my_printf_error(ER_GET_ERRNO, "Cannot write ScyllaDB result spill file in %s: %s",
+                      MYF(0), mysql_tmpdir, strerror(result_set.spill_error()));
+      release_result_memory();
+      result_set.reset();
+      DBUG_RETURN(HA_ERR_GENERIC);
+    }
+    
+    if (limit_rc) {
+      my_printf_error(ER_OUTOFMEMORY,
+                      "ScyllaDB result buffers exceed scylla_max_result_memory (%llu bytes)",
+                      MYF(0), (unsigned long long) THDVAR(thd, max_result_memory));
+      release_result_memory();
+      result_set.reset();
+      DBUG_RETURN(limit_rc);
+    }
+    
+    account_result_memory(true);
+    map_result_columns();
+    
+    if (!ok && scylla_statement_interrupted(thd)) {
+      // Remaining pages were not fetched
+      release_result_memory();
+      result_set.reset();
+      DBUG_RETURN(HA_ERR_ABORTED_BY_USER);
+    }
+    
+    if (!ok) {
+      my_printf_error(ER_GET_ERRNO, "CQL execution failed: %s",
+                      MYF(0), cql.c_str());
+      release_result_memory();
+      result_set.reset();
+      DBUG_RETURN(HA_ERR_GENERIC);
+    }
+    
+    // Debug: Log column names received from ScyllaDB
+    if (options->verbose && global_system_variables.log_warnings >= 3 && !column_names.empty()) {
+      std::ostringstream cols;
+      for (size_t i = 0; i < column_names.size(); i++) {
+        if (i > 0) cols << ", ";
+        cols << column_names[i];
+      }
+      sql_print_information("Scylla: Table %s.%s: Received %zu columns from CQL: %s",
+                           options->keyspace.c_str(), options->table.c_str(),
+                           column_names.size(), cols.str().c_str());
+    }
+    
+    if (result_set.is_spilled() && options->verbose && global_system_variables.log_warnings >= 3) {
+      sql_print_information("Scylla: Table %s.%s: Spilled %llu bytes of results to disk",
+                           options->keyspace.c_str(), options->table.c_str(),
+                           (unsigned long long)result_set.spilled_bytes());
+    }
+  }
+  catch (const std::exception &e) {
+    my_printf_error(ER_GET_ERRNO, "CQL execution error: %s", MYF(0), e.what());
+    release_result_memory();
+    result_set.reset();
+    DBUG_RETURN(HA_ERR_GENERIC);
+  }
+  
+  DBUG_RETURN(0);
+}
+
+/**
+ * Map every field to its column in the current result, matching names
+ * case-insensitively, so rows can be stored without name lookups
+ */
+void ha_scylla::map_result_columns()
+{
+  std::map<std::string, int> column_map;
+  for (size_t i = 0; i < column_names.size(); i++) {
+    std::string col_name_lower = column_names[i];
+    std::transform(col_name_lower.begin(), col_name_lower.end(), col_name_lower.begin(), ::tolower);
+    column_map[col_name_lower] = (int) i;
+  }
+  
+  field_columns.assign(table->s->fields, -1);
+  for (uint i = 0; i < table->s->fields; i++) {
+    Field *field = table->field[i];
+    std::string field_name_lower(field->field_name.str, field->field_name.length);
+    std::transform(field_name_lower.begin(), field_name_lower.end(), field_name_lower.begin(), ::tolower);
+    std::map<std::string, int>::const_iterator it = column_map.find(field_name_lower);
+    if (it != column_map.end()) {
+      field_columns[i] = it->second;
+    }
+  }
+}
+
+/**
+ * Row cache TTL of the table in milliseconds, 0 if it is not cached
+ */
+long ha_scylla::row_cache_ttl() const
+{
+  if (!share || !scylla_row_cache.enabled() || table->s->primary_key == MAX_KEY) {
+    return 0;
+  }
+  return options->cache_ttl >= 0 ? options->cache_ttl : (long) scylla_row_cache_ttl;
+}
+
+/**
+ * Row cache key of the primary key of a row
+ */
+std::string ha_scylla::row_cache_key(const uchar *record)
+{
+  KEY *key_info = &table->key_info[table->s->primary_key];
+  std::vector<uchar> key(key_info->key_length);
+  
+  key_copy(key.data(), record, key_info, key_info->key_length, true);
+  return share->cache_key(key.data(), key_info->key_length);
+}
+
+/**
+ * Key to invalidate when a row is written, empty if reads of the table are
+ * neither cached nor coalesced
+ */
+std::string ha_scylla::invalidation_key(const uchar *record)
+{
+  if (!share || table->s->primary_key == MAX_KEY ||
+      (row_cache_ttl() <= 0 && !scylla_coalesce_reads)) {
+    return std::string();
+  }
+  return row_cache_key(record);
+}
+
+/**
+ * Drop the cached lookup of a written row and detach any read of it in
+ * flight, so later readers see the write
+ */
+static void invalidate_row_key(const std::string &key)
+{
+  if (!key.empty()) {
+    scylla_row_cache.invalidate(key);
+    scylla_single_flight.invalidate(key);
+  }
+}
+
+/**
+ * Invalidate a row written through this handler
+ */
+void ha_scylla::invalidate_cached_row(const uchar *record)
+{
+  invalidate_row_key(invalidation_key(record));
+}
+
+/**
+ * Replace the result set with a cached lookup result
+ */
+void ha_scylla::load_cached_result(const ScyllaRowCache::Entry &entry)
+{
+  release_result_memory();
+  result_set.reset();
+  
+  column_names = entry.column_names;
+  for (size_t i = 0; i < entry.rows.size(); i++) {
+    std::vector<std::string> row(entry.rows[i]);
+    result_set.append(row);
+  }
+  
+  account_result_memory(true);
+  map_result_columns();
+}
+
+/**
+ * Charge result buffer growth to the session and enforce
+ * scylla_max_result_memory
+ * @param force Charge even if the change is below the accounting chunk
+ * @return 0, or HA_ERR_OUT_OF_MEM if the query must be aborted
+ */
+int ha_scylla::account_result_memory(bool force)
+{
+  longlong current = (longlong) (result_set.memory_used() +
+                                 ScyllaResultBuffer::row_footprint(column_names));
+  longlong delta = current - accounted_memory;
+  
+  if (!force && delta < MEMORY_ACCOUNTING_CHUNK && delta > -MEMORY_ACCOUNTING_CHUNK) {
+    return 0;
+  }
+  
+  THD *thd = ha_thd();
+  if (accounted_thd && accounted_thd != thd) {
+    release_result_memory();
+    delta = current;
+  }
+  
+  accounted_thd = thd;
+  accounted_memory = current;
+  longlong session_total = scylla_charge_memory(thd, delta);
+  
+  ulonglong limit = THDVAR(thd, max_result_memory);
+  if (!limit || delta <= 0 || session_total <= (longlong) limit) {
+    return 0;
+  }
+  
+  if (THDVAR(thd, result_memory_action) == SCYLLA_MEMORY_ACTION_SPILL) {
+    // Keep what is buffered and stream the rest of the result to disk
+    if (!result_set.is_spilled()) {
+      result_set.spill_from_now();
+      scylla_memory_limit_hits++;
+    }
+    return 0;
+  }
+  
+  scylla_memory_limit_hits++;
+  return HA_ERR_OUT_OF_MEM;
+}
+
+/**
+ * Return all result memory charged by this handler
+ */
+void ha_scylla::release_result_memory()
+{
+  if (accounted_memory && accounted_thd) {
+    scylla_charge_memory(accounted_thd, -accounted_memory);
+  }
+  
+  accounted_memory = 0;
+  accounted_thd = NULL;
+}
+
+/**
+ * Return table capabilities
+ */
+ulonglong ha_scylla::table_flags() const
+{
+  return (HA_BINLOG_ROW_CAPABLE | HA_BINLOG_STMT_CAPABLE |
+          HA_NO_TRANSACTIONS | HA_REC_NOT_IN_SEQ |
+          HA_NULL_IN_KEY | HA_CAN_GEOMETRY | HA_CAN_INDEX_BLOBS |
+          HA_AUTO_PART_KEY | HA_CAN_RTREEKEYS);
+}
+
+/**
+ * Return index capabilities
+ */
+ulong ha_scylla::index_flags(uint idx, uint part, bool all_parts) const
+{
+  return (HA_READ_NEXT | HA_READ_PREV | HA_READ_ORDER | HA_READ_RANGE |
+          HA_KEYREAD_ONLY);
+}
+
+/**
+ * Create ScyllaDB table
+ */
+int ha_scylla::create_scylla_table(const char *name, TABLE *form)
+{
+  DBUG_ENTER("ha_scylla::create_scylla_table");
+  
+  ScyllaQueryBuilder builder;
+  std::string cql = builder.build_create_table_cql(form, options->keyspace, options->table);
+  
+  int rc = execute_cql(cql);
+  if (rc) {
+    DBUG_RETURN(rc);
+  }
+  
+  DBUG_RETURN(0);
+}
+
+/**
+ * Create table
+ */
+int ha_scylla::create(const char *name, TABLE *form, HA_CREATE_INFO *create_info)
+{
+  DBUG_ENTER("ha_scylla::create");
+  
+  // Parse table comment for connection parameters
+  ddl_options.init(create_info->comment.str, name);
+  options = &ddl_options;
+  
+  int rc = connect_to_scylla();
+  if (rc) {
+    DBUG_RETURN(rc);
+  }
+  
+  // Create keyspace if it doesn't exist
+  std::string create_ks_cql = "CREATE KEYSPACE IF NOT EXISTS " + options->keyspace +
+                              " WITH replication = {'class': 'SimpleStrategy', 'replication_factor': 1}";
+  execute_cql(create_ks_cql);
+  
+  // Create table in ScyllaDB
+  rc = create_scylla_table(name, form);
+  
+  DBUG_RETURN(rc);
+}
+
+/**
+ * Open table
+ */
+int ha_scylla::open(const char *name, int mode, uint test_if_locked)
+{
+  DBUG_ENTER("ha_scylla::open");
+  
+  if (!(share = get_share())) {
+    DBUG_RETURN(HA_ERR_OUT_OF_MEM);
+  }
+  
+  // Options, connection and schema are set up once per table
+  lock_shared_ha_data();
+  int rc = share->init(table, name);
+  unlock_shared_ha_data();
+  if (rc) {
+    DBUG_RETURN(rc);
+  }
+  
+  options = &share->options;
+  conn = share->conn;
+  
+  // MariaDB keeps a null-bitmap byte at the start when nullable fields exist.
+  // For some table layouts, field[0] may still point at offset 0 while field[1]
+  // already accounts for the null byte; shift field[0] once to keep reads/writes
+  // from overlapping the null bitmap.
+  if (table->s->null_bytes > 0 && table->s->fields > 1) {
+    Field *first = table->field[0];
+    Field *second = table->field[1];
+    my_ptrdiff_t first_off = first->ptr - table->record[0];
+    my_ptrdiff_t second_off = second->ptr - table->record[0];
+    my_ptrdiff_t expected_second = first_off + first->pack_length() + table->s->null_bytes;
+    
+    if (first->null_ptr == nullptr && first_off == 0 && second_off == expected_second) {
+      first->move_field(first->ptr + table->s->null_bytes);
+      if (options->verbose && global_system_variables.log_warnings >= 3) {
+        std::string first_name(first->field_name.str, first->field_name.length);
+        sql_print_information("Scylla: Table %s.%s: Adjusted field[0] '%s' offset to %ld to avoid null bitmap overlap",
+                             options->keyspace.c_str(), options->table.c_str(),
+                             first_name.c_str(), (long)(first->ptr - table->record[0]));
+      }
+    }
+  }
+  
+  // Initialize lock data structure
+  thr_lock_data_init(&share->lock, &lock, NULL);
+  
+  DBUG_RETURN(0);
+}
+
+/**
+ * Close table
+ */
+int ha_scylla::close(void)
+{
+  DBUG_ENTER("ha_scylla::close");
+  
+  // Outstanding bulk inserts and write-behind writes reference the share
+  close_write_behind();
+  bulk_batches.clear();
+  bulk_executor.reset();
+  bulk_concurrency = 0;
+  bulk_batch_rows = 0;
+  bulk_delete = false;
+  release_result_memory();
+  result_set.reset();
+  scan_conn.reset();
+  conn.reset();
+  
+  DBUG_RETURN(0);
+}
+
+/**
+ * Delete table
+ */
+int ha_scylla::delete_table(const char *name)
+{
+  DBUG_ENTER("ha_scylla::delete_table");
+  
+  if (!share) {
+    ddl_options.init(NULL, name);
+    options = &ddl_options;
+  }
+  
   int rc = connect_to_scylla();
   if (rc) {
     DBUG_RETURN(rc);
   }
   
-  try {
-    if (!conn->execute(cql, column_names, result_set)) {
-      my_printf_error(ER_GET_ERRNO, "CQL execution failed: %s",
-                      MYF(0), cql.c_str());
-      DBUG_RETURN(HA_ERR_GENERIC);
-    }
-    
-    // Debug: Log column names received from ScyllaDB
-    if (verbose_logging && global_system_variables.log_warnings >= 3 && !column_names.empty()) {
-      std::ostringstream cols;
-      for (size_t i = 0; i < column_names.size(); i++) {
-        if (i > 0) cols << ", ";
-        cols << column_names[i];
-      }
-      sql_print_information("Scylla: Table %s.%s: Received %zu columns from CQL: %s",
-                           keyspace_name.c_str(), table_name.c_str(),
-                           column_names.size(), cols.str().c_str());
-    }
-  }
-  catch (const std::exception &e) {
-    my_printf_error(ER_GET_ERRNO, "CQL execution error: %s", MYF(0), e.what());
-    DBUG_RETURN(HA_ERR_GENERIC);
+  std::string cql = "DROP TABLE IF EXISTS " + options->keyspace + "." + options->table;
+  rc = execute_cql(cql);
+  
+  DBUG_RETURN(rc);
+}
+
+/**
+ * Truncate table
+ */
+int ha_scylla::truncate()
+{
+  DBUG_ENTER("ha_scylla::truncate");
+  
+  std::string cql = "TRUNCATE " + share->qualified_name;
+  int rc = execute_cql(cql);
+  
+  // Cached rows are dropped even if the truncate failed part way
+  share->cache_epoch = ++scylla_cache_epochs;
+  
+  if (rc == 0) {
+    share->estimated_rows = 0;
   }
   
-  DBUG_RETURN(0);
+  DBUG_RETURN(rc);
 }
 
 /**
- * Return table capabilities
+ * Rename table
  */
-ulonglong ha_scylla::table_flags() const
+int ha_scylla::rename_table(const char *from, const char *to)
 {
-  return (HA_BINLOG_ROW_CAPABLE | HA_BINLOG_STMT_CAPABLE |
-          HA_NO_TRANSACTIONS | HA_REC_NOT_IN_SEQ |
-          HA_NULL_IN_KEY | HA_CAN_GEOMETRY | HA_CAN_INDEX_BLOBS |
-          HA_AUTO_PART_KEY | HA_CAN_RTREEKEYS);
+  DBUG_ENTER("ha_scylla::rename_table");
+  
+  // ScyllaDB doesn't support table rename directly
+  // Would need to create new table and migrate data
+  my_printf_error(ER_ILLEGAL_HA, "ScyllaDB storage engine does not support table rename", MYF(0));
+  
+  DBUG_RETURN(HA_ERR_WRONG_COMMAND);
 }
 
 /**
- * Return index capabilities
+ * Check if query needs ALLOW FILTERING
  */
-ulong ha_scylla::index_flags(uint idx, uint part, bool all_parts) const
+bool ha_scylla::needs_allow_filtering(TABLE *table_arg)
 {
-  return (HA_READ_NEXT | HA_READ_PREV | HA_READ_ORDER | HA_READ_RANGE |
-          HA_KEYREAD_ONLY);
+  // For now, always add ALLOW FILTERING to SELECT queries
+  // In production, this should be more intelligent based on the query structure
+  return true;
 }
 
 /**
- * Create ScyllaDB table
+ * Store result row to MariaDB record buffer
  */
-int ha_scylla::create_scylla_table(const char *name, TABLE *form)
+int ha_scylla::store_result_to_record(uchar *buf, size_t row_index)
 {
-  DBUG_ENTER("ha_scylla::create_scylla_table");
+  DBUG_ENTER("ha_scylla::store_result_to_record");
   
-  if (table_name.empty()) {
-    // Extract table name from full name
-    const char *table_ptr = strrchr(name, '/');
-    if (table_ptr) {
-      table_name = table_ptr + 1;
+  if (row_index >= result_set.size()) {
+    DBUG_RETURN(HA_ERR_END_OF_FILE);
+  }
+  
+  const std::vector<std::string> *row_ptr = result_set.get_row(row_index);
+  if (!row_ptr) {
+    my_printf_error(ER_GET_ERRNO, "Cannot read ScyllaDB result spill file: %s",
+                    MYF(0), strerror(result_set.spill_error()));
+    DBUG_RETURN(HA_ERR_GENERIC);
+  }
+  
+  MY_BITMAP *old_map = table->write_set;
+  dbug_tmp_use_all_columns(table, &table->write_set);
+  
+  const std::vector<std::string> &row = *row_ptr;
+  
+  if (options->verbose && global_system_variables.log_warnings >= 3) {
+    sql_print_information("Scylla: Table %s.%s: store_result_to_record row %zu, buf=%p, table->record[0]=%p, offset=%lld",
+                         options->keyspace.c_str(), options->table.c_str(), row_index, 
+                         buf, table->record[0], (long long)(buf - table->record[0]));
+    sql_print_information("Scylla: Table %s.%s: record layout: null_bytes=%u, null_fields=%u, reclength=%u, null_flags=%p",
+                         options->keyspace.c_str(), options->table.c_str(),
+                         (unsigned)table->s->null_bytes, (unsigned)table->s->null_fields,
+                         (unsigned)table->s->reclength, table->null_flags);
+  }
+  
+  // Move all fields to point to the provided buffer instead of table->record[0]
+  my_ptrdiff_t offset = buf - table->record[0];
+  if (offset) {
+    for (uint i = 0; i < table->s->fields; i++) {
+      table->field[i]->move_field_offset(offset);
+    }
+  }
+  
+  // Clear the buffer to zero (safe for all types)
+  memset(buf, 0, table->s->reclength);
+  
+  // Fields are mapped to result columns by name once per result,
+  // see map_result_columns()
+  for (uint i = 0; i < table->s->fields; i++) {
+    Field *field = table->field[i];
+    const char *field_name = field->field_name.str;
+    // Debug: print offset and raw bytes for animal_id
+    if (options->verbose && global_system_variables.log_warnings >= 3) {
+      sql_print_information("Scylla: Table %s.%s: Field '%s' offset in record: %ld, field->ptr=%p, buf=%p",
+        options->keyspace.c_str(), options->table.c_str(), field_name,
+        (long)(field->ptr - buf), field->ptr, buf);
+      if ((i == 0 || i == 1) && field->null_ptr) {
+        sql_print_information("Scylla: Table %s.%s: Field '%s' null_ptr=%p (offset %ld), null_bit=0x%02x",
+          options->keyspace.c_str(), options->table.c_str(), field_name,
+          field->null_ptr, (long)((uchar*)field->null_ptr - buf), (unsigned)field->null_bit);
+      }
+      if (strcmp(field_name, "animal_id") == 0) {
+        unsigned char *p = (unsigned char*)field->ptr;
+        char hex[32];
+        snprintf(hex, sizeof(hex), "%02x %02x %02x %02x", p[0], p[1], p[2], p[3]);
+        sql_print_information("Scylla: Table %s.%s: animal_id raw bytes: %s", options->keyspace.c_str(), options->table.c_str(), hex);
+      }
+    }
+    int col = i < field_columns.size() ? field_columns[i] : -1;
+    if (col >= 0 && (size_t) col < row.size()) {
+      size_t col_idx = (size_t) col;
+      if (options->verbose && global_system_variables.log_warnings >= 3) {
+        sql_print_information("Scylla: Table %s.%s: Mapping field '%s' -> column[%zu] = '%s', field->ptr=%p",
+                             options->keyspace.c_str(), options->table.c_str(),
+                             field_name, col_idx, row[col_idx].c_str(), field->ptr);
+      }
+      if (row[col_idx].empty() || row[col_idx] == "NULL") {
+        field->set_null();
+      } else {
+        field->set_notnull();
+        ScyllaTypes::store_field_value(field, row[col_idx]);
+        // Debug: For integer fields, read back the value we just stored
+        if (options->verbose && global_system_variables.log_warnings >= 3 && 
+            (field->type() == MYSQL_TYPE_LONG || field->type() == MYSQL_TYPE_LONGLONG)) {
+          longlong stored_val = field->val_int();
+          sql_print_information("Scylla: Table %s.%s: Stored integer value for '%s': wrote '%s', read back %lld",
+                               options->keyspace.c_str(), options->table.c_str(),
+                               field_name, row[col_idx].c_str(), stored_val);
+        }
+      }
+      if (options->verbose && global_system_variables.log_warnings >= 3) {
+        unsigned char *p = (unsigned char*)buf;
+        char hex[32];
+        snprintf(hex, sizeof(hex), "%02x %02x %02x %02x %02x %02x %02x %02x",
+                 p[0], p[1], p[2], p[3], p[4], p[5], p[6], p[7]);
+        sql_print_information("Scylla: Table %s.%s: Row bytes after field '%s': %s",
+                             options->keyspace.c_str(), options->table.c_str(),
+                             field_name, hex);
+      }
     } else {
-      table_name = name;
+      // Column not found in result set - set to NULL
+      if (options->verbose && global_system_variables.log_warnings >= 3) {
+        sql_print_information("Scylla: Table %s.%s: Field '%s' not found in result columns",
+                             options->keyspace.c_str(), options->table.c_str(), field_name);
+      }
+      field->set_null();
     }
   }
   
-  ScyllaQueryBuilder builder;
-  std::string cql = builder.build_create_table_cql(form, keyspace_name, table_name);
+  // Final debug: Check what animal_id actually contains in the buffer before returning
+  if (options->verbose && global_system_variables.log_warnings >= 3) {
+    for (uint i = 0; i < table->s->fields; i++) {
+      Field *field = table->field[i];
+      std::string field_name(field->field_name.str, field->field_name.length);
+      if (field_name == "animal_id" || field_name == "habitat_id" || field_name == "feeding_id") {
+        longlong final_val = field->val_int();
+        
+        sql_print_information("Scylla: Table %s.%s: Final check before return: '%s' = %lld (in buffer %p)",
+                             options->keyspace.c_str(), options->table.c_str(),
+                             field_name.c_str(), final_val, buf);
+      }
+    }
+  }
   
-  int rc = execute_cql(cql);
-  if (rc) {
-    DBUG_RETURN(rc);
+  // Restore field pointers to table->record[0] if we moved them
+  if (offset) {
+    for (uint i = 0; i < table->s->fields; i++) {
+      table->field[i]->move_field_offset(-offset);
+    }
   }
   
+  dbug_tmp_restore_column_map(&table->write_set, old_map);
+  
   DBUG_RETURN(0);
 }
 
 /**
- * Create table
+ * Write row
  */
-int ha_scylla::create(const char *name, TABLE *form, HA_CREATE_INFO *create_info)
+int ha_scylla::write_row(const uchar *buf)
 {
-  DBUG_ENTER("ha_scylla::create");
+  DBUG_ENTER("ha_scylla::write_row");
   
-  // Parse table comment for connection parameters
-  if (create_info->comment.str) {
-    parse_table_comment(create_info->comment.str);
+  // A REPLACE allowed to overwrite needs no read; CQL INSERT replaces the
+  // row in one request. The read only sees acknowledged writes, so checked
+  // rows are written synchronously and pending write-behind writes are
+  // waited for first
+  bool check = options->duplicate_keys == SCYLLA_DUPLICATE_KEY_CHECK && !write_can_replace;
+  if (check) {
+    int rc = flush_write_behind();
+    if (rc == 0) {
+      rc = check_duplicate_key(buf);
+    }
+    if (rc) {
+      DBUG_RETURN(rc);
+    }
   }
   
-  // Use defaults if not specified
-  if (keyspace_name.empty()) {
-    keyspace_name = scylla_default_keyspace ? scylla_default_keyspace : "mariadb";
+  // Bind the row to the prepared INSERT; CQL literals are the fallback
+  const ScyllaStatementTemplate &tpl = share->insert_template;
+  CassStatement *statement = bind_template(tpl, buf);
+  std::string cql = tpl.cql;
+  if (!statement) {
+    ScyllaQueryBuilder builder;
+    cql = builder.build_insert_cql(table, buf, options->keyspace, options->table);
   }
   
-  int rc = connect_to_scylla();
-  if (rc) {
-    DBUG_RETURN(rc);
+  if (options->verbose && global_system_variables.log_warnings >= 3) {
+    sql_print_information("Scylla: Table %s.%s: Executing INSERT %s",
+                         options->keyspace.c_str(), options->table.c_str(), cql.c_str());
   }
   
-  // Create keyspace if it doesn't exist
-  std::string create_ks_cql = "CREATE KEYSPACE IF NOT EXISTS " + keyspace_name +
-                              " WITH replication = {'class': 'SimpleStrategy', 'replication_factor': 1}";
-  execute_cql(create_ks_cql);
+  if (bulk_concurrency > 1 && !check) {
+    DBUG_RETURN(submit_bulk_write(buf, cql, statement, &share->rows_written));
+  }
+  if (options->write_behind && !check) {
+    DBUG_RETURN(submit_write_behind(cql, statement, buf, NULL, &share->rows_written));
+  }
   
-  conn->use_keyspace(keyspace_name);
+  int rc = execute_cql(cql, statement, buf);
+  // Even a failed write may have been applied
+  invalidate_cached_row(buf);
+  if (rc == 0) {
+    share->rows_written++;
+  }
   
-  // Create table in ScyllaDB
-  rc = create_scylla_table(name, form);
+  if (rc == 0 && options->verbose && global_system_variables.log_warnings >= 3) {
+    sql_print_information("Scylla: Table %s.%s: Successfully INSERTed 1 row",
+                         options->keyspace.c_str(), options->table.c_str());
+  }
   
   DBUG_RETURN(rc);
 }
 
 /**
- * Open table
+ * Create an executor of pipelined writes on the bulk connection
+ * @return NULL with the error reported if there is no connection
  */
-int ha_scylla::open(const char *name, int mode, uint test_if_locked)
+ScyllaExecutor *ha_scylla::new_write_executor(size_t max_in_flight)
 {
-  DBUG_ENTER("ha_scylla::open");
+  DBUG_ENTER("ha_scylla::new_write_executor");
   
-  // Parse table share comment
-  if (table->s->comment.str) {
-    parse_table_comment(table->s->comment.str);
+  if (connect_to_scylla()) {
+    DBUG_RETURN(NULL);
+  }
+  const std::shared_ptr<ScyllaConnection> &bulk_conn =
+    workload_connection(ScyllaClusterOptions::PROFILE_BULK);
+  if (!bulk_conn) {
+    DBUG_RETURN(NULL);
   }
   
-  // Extract table name if not specified
-  if (table_name.empty()) {
-    const char *table_ptr = strrchr(name, '/');
-    if (table_ptr) {
-      table_name = table_ptr + 1;
-    } else {
-      table_name = name;
-    }
+  ScyllaConcurrencyLimit *shared_limit =
+    scylla_adaptive_write_concurrency ? &bulk_conn->write_limit : NULL;
+  DBUG_RETURN(new ScyllaExecutor(bulk_conn, max_in_flight, shared_limit,
+                                 scylla_max_write_concurrency, write_retry_policy()));
+}
+
+/**
+ * Hand a write to an executor without waiting for it
+ * @param row Row whose cached copy the write invalidates
+ * @param old_row Previous image of an updated row, or NULL
+ * @param counter Share counter of applied writes
+ */
+int ha_scylla::submit_write(ScyllaExecutor *executor, const std::string &cql,
+                            CassStatement *statement, const uchar *row,
+                            const uchar *old_row, std::atomic<ulonglong> *counter)
+{
+  DBUG_ENTER("ha_scylla::submit_write");
+  
+  std::unique_ptr<CassStatement, void (*)(CassStatement*)>
+    statement_guard(statement, [](CassStatement *stmt) { if (stmt) cass_statement_free(stmt); });
+  
+  if (!statement) {
+    statement = cass_statement_new(cql.c_str(), 0);
+    statement_guard.reset(statement);
   }
   
-  // Use defaults if not specified
-  if (keyspace_name.empty()) {
-    keyspace_name = scylla_default_keyspace ? scylla_default_keyspace : "mariadb";
+  if (!throttle_write(table->s->reclength)) {
+    DBUG_RETURN(HA_ERR_ABORTED_BY_USER);
   }
   
-  int rc = connect_to_scylla();
+  int rc = prepare_statement(statement, true, ScyllaClusterOptions::PROFILE_BULK, true);
   if (rc) {
     DBUG_RETURN(rc);
   }
+  pin_write_timestamp(statement);
+  
+  // Invalidate again on completion: a read between now and then could
+  // cache the old row
+  std::string key = invalidation_key(row);
+  std::string old_key = old_row ? invalidation_key(old_row) : std::string();
+  invalidate_row_key(key);
+  if (old_row) {
+    invalidate_row_key(old_key);
+  }
   
-  // MariaDB keeps a null-bitmap byte at the start when nullable fields exist.
-  // For some table layouts, field[0] may still point at offset 0 while field[1]
-  // already accounts for the null byte; shift field[0] once to keep reads/writes
-  // from overlapping the null bitmap.
-  if (table->s->null_bytes > 0 && table->s->fields > 1) {
-    Field *first = table->field[0];
-    Field *second = table->field[1];
-    my_ptrdiff_t first_off = first->ptr - table->record[0];
-    my_ptrdiff_t second_off = second->ptr - table->record[0];
-    my_ptrdiff_t expected_second = first_off + first->pack_length() + table->s->null_bytes;
-    
-    if (first->null_ptr == nullptr && first_off == 0 && second_off == expected_second) {
-      first->move_field(first->ptr + table->s->null_bytes);
-      if (verbose_logging && global_system_variables.log_warnings >= 3) {
-        std::string first_name(first->field_name.str, first->field_name.length);
-        sql_print_information("Scylla: Table %s.%s: Adjusted field[0] '%s' offset to %ld to avoid null bitmap overlap",
-                             keyspace_name.c_str(), table_name.c_str(),
-                             first_name.c_str(), (long)(first->ptr - table->record[0]));
+  bool ok = executor->submit(statement_guard.release(), [counter, key, old_key](bool applied) {
+    invalidate_row_key(key);
+    if (!old_key.empty()) {
+      invalidate_row_key(old_key);
+    }
+    if (applied) {
+      (*counter)++;
+    }
+  });
+  
+  if (!ok) {
+    if (scylla_statement_interrupted(ha_thd())) {
+      DBUG_RETURN(HA_ERR_ABORTED_BY_USER);
+    }
+    my_printf_error(ER_GET_ERRNO, "CQL execution failed: %s",
+                    MYF(0), executor->first_error().c_str());
+    DBUG_RETURN(HA_ERR_GENERIC);
+  }
+  
+  DBUG_RETURN(0);
+}
+
+/**
+ * Hand a row of a multi-row INSERT or DELETE to the bulk executor without
+ * waiting for it, batched with rows of the same replica when
+ * scylla_bulk_batch_rows allows. Failures are reported by
+ * end_bulk_insert() and end_bulk_delete().
+ */
+int ha_scylla::submit_bulk_write(const uchar *buf, const std::string &cql,
+                                 CassStatement *statement, std::atomic<ulonglong> *counter)
+{
+  DBUG_ENTER("ha_scylla::submit_bulk_write");
+  
+  if (!bulk_executor) {
+    bulk_executor.reset(new_write_executor(bulk_concurrency));
+    if (!bulk_executor) {
+      if (statement) {
+        cass_statement_free(statement);
       }
+      DBUG_RETURN(HA_ERR_NO_CONNECTION);
     }
   }
   
-  // Initialize lock data structure
-  thr_lock_data_init(&thr_lock, &lock, NULL);
+  int64_t token;
+  if (!bulk_batch_rows || !partition_token(buf, &token)) {
+    DBUG_RETURN(submit_write(bulk_executor.get(), cql, statement, buf, NULL, counter));
+  }
+  
+  std::unique_ptr<CassStatement, void (*)(CassStatement*)>
+    statement_guard(statement, [](CassStatement *stmt) { if (stmt) cass_statement_free(stmt); });
+  
+  if (!statement) {
+    statement = cass_statement_new(cql.c_str(), 0);
+    statement_guard.reset(statement);
+  }
+  
+  if (!throttle_write(table->s->reclength)) {
+    DBUG_RETURN(HA_ERR_ABORTED_BY_USER);
+  }
+  
+  // Used when the row ends up alone in its batch
+  int rc = prepare_statement(statement, true, ScyllaClusterOptions::PROFILE_BULK, true);
+  if (rc) {
+    DBUG_RETURN(rc);
+  }
+  
+  ScyllaBatchBuilder::Row row;
+  row.timestamp = pin_write_timestamp(statement);
+  row.token = token;
+  row.bytes = table->s->reclength;
+  row.tag = invalidation_key(buf);
+  invalidate_row_key(row.tag);
+  row.statement = statement_guard.release();
+  
+  ScyllaBatchBuilder::Batch full;
+  if (bulk_batches.add(row, conn->token_owner(token), full)) {
+    DBUG_RETURN(send_batch(full, counter));
+  }
   
   DBUG_RETURN(0);
 }
 
 /**
- * Close table
+ * Send the rows of a batch builder batch through the bulk executor, as an
+ * UNLOGGED batch unless there is only one
  */
-int ha_scylla::close(void)
+int ha_scylla::send_batch(ScyllaBatchBuilder::Batch &rows, std::atomic<ulonglong> *counter)
 {
-  DBUG_ENTER("ha_scylla::close");
+  DBUG_ENTER("ha_scylla::send_batch");
+  
+  // Invalidate again on completion: a read between now and then could
+  // cache the old rows
+  std::vector<std::string> keys;
+  for (size_t i = 0; i < rows.size(); i++) {
+    keys.push_back(rows[i].tag);
+  }
+  ScyllaExecutor::Completion done = [keys, counter](bool applied) {
+    for (size_t i = 0; i < keys.size(); i++) {
+      invalidate_row_key(keys[i]);
+    }
+    if (applied) {
+      (*counter) += keys.size();
+    }
+  };
+  
+  bool ok;
+  if (rows.size() == 1) {
+    ok = bulk_executor->submit(rows[0].statement, done);
+  } else {
+    CassBatch *batch = cass_batch_new(CASS_BATCH_TYPE_UNLOGGED);
+    for (size_t i = 0; i < rows.size(); i++) {
+      cass_batch_add_statement(batch, rows[i].statement);
+      cass_statement_free(rows[i].statement);
+    }
+    
+    // Batches ignore the settings of their statements
+    ScyllaClusterOptions::Profile profile =
+      options->execution_profile != ScyllaClusterOptions::PROFILE_COUNT
+        ? options->execution_profile : ScyllaClusterOptions::PROFILE_BULK;
+    cass_batch_set_execution_profile(batch, ScyllaClusterOptions::profile_name(profile));
+    CassConsistency consistency = statement_consistency(true);
+    if (consistency != CASS_CONSISTENCY_UNKNOWN) {
+      cass_batch_set_consistency(batch, consistency);
+    }
+    // A batch has one timestamp; the latest of its rows still precedes
+    // every row issued after them, also when the batch is retried
+    if (options->cluster.client_timestamps) {
+      int64_t timestamp = 0;
+      for (size_t i = 0; i < rows.size(); i++) {
+        timestamp = std::max(timestamp, rows[i].timestamp);
+      }
+      cass_batch_set_timestamp(batch, timestamp);
+      cass_batch_set_is_idempotent(batch, cass_true);
+      cass_batch_set_retry_policy(batch, ScyllaRetryPolicy::driver_policy());
+    }
+    
+    ok = bulk_executor->submit_batch(batch, done);
+  }
+  rows.clear();
+  
+  if (!ok) {
+    if (scylla_statement_interrupted(ha_thd())) {
+      DBUG_RETURN(HA_ERR_ABORTED_BY_USER);
+    }
+    my_printf_error(ER_GET_ERRNO, "CQL execution failed: %s",
+                    MYF(0), bulk_executor->first_error().c_str());
+    DBUG_RETURN(HA_ERR_GENERIC);
+  }
+  
   DBUG_RETURN(0);
 }
 
 /**
- * Delete table
+ * Send the rows still waiting in the batch builder, then wait for all
+ * writes of the multi-row statement
+ * @param counter Share counter of the rows written
  */
-int ha_scylla::delete_table(const char *name)
+int ha_scylla::finish_bulk_writes(std::atomic<ulonglong> *counter)
 {
-  DBUG_ENTER("ha_scylla::delete_table");
+  DBUG_ENTER("ha_scylla::finish_bulk_writes");
   
-  if (table_name.empty()) {
-    const char *table_ptr = strrchr(name, '/');
-    if (table_ptr) {
-      table_name = table_ptr + 1;
-    } else {
-      table_name = name;
+  bulk_concurrency = 0;
+  bulk_batch_rows = 0;
+  if (!bulk_executor) {
+    DBUG_RETURN(0);
+  }
+  
+  int rc = 0;
+  std::vector<ScyllaBatchBuilder::Batch> batches;
+  bulk_batches.drain(batches);
+  for (size_t i = 0; i < batches.size(); i++) {
+    if (rc == 0) {
+      rc = send_batch(batches[i], counter);
+      continue;
+    }
+    for (size_t r = 0; r < batches[i].size(); r++) {
+      cass_statement_free(batches[i][r].statement);
     }
   }
   
-  int rc = connect_to_scylla();
+  // A killed statement stops waiting, but the executor still drains the
+  // requests already sent (bounded by their statement timeout)
+  bool ok = bulk_executor->wait();
+  std::string error = bulk_executor->first_error();
+  bulk_executor.reset();
+  
   if (rc) {
     DBUG_RETURN(rc);
   }
   
-  std::string cql = "DROP TABLE IF EXISTS " + keyspace_name + "." + table_name;
-  rc = execute_cql(cql);
+  if (!ok && scylla_statement_interrupted(ha_thd())) {
+    DBUG_RETURN(HA_ERR_ABORTED_BY_USER);
+  }
   
-  DBUG_RETURN(rc);
+  if (!ok) {
+    my_printf_error(ER_GET_ERRNO, "CQL execution failed: %s", MYF(0), error.c_str());
+    DBUG_RETURN(HA_ERR_GENERIC);
+  }
+  
+  DBUG_RETURN(0);
 }
 
 /**
- * Truncate table
+ * Hand a write of a scylla_write_behind table to the executor without
+ * waiting for it. Failures are reported by flush_write_behind().
  */
-int ha_scylla::truncate()
+int ha_scylla::submit_write_behind(const std::string &cql, CassStatement *statement,
+                                   const uchar *row, const uchar *old_row,
+                                   std::atomic<ulonglong> *counter)
 {
-  DBUG_ENTER("ha_scylla::truncate");
+  DBUG_ENTER("ha_scylla::submit_write_behind");
   
-  std::string cql = "TRUNCATE " + keyspace_name + "." + table_name;
-  int rc = execute_cql(cql);
+  if (!write_behind_executor) {
+    write_behind_executor.reset(new_write_executor(options->write_behind));
+    if (!write_behind_executor) {
+      if (statement) {
+        cass_statement_free(statement);
+      }
+      DBUG_RETURN(HA_ERR_NO_CONNECTION);
+    }
+    std::lock_guard<std::mutex> lock(scylla_write_behind_mutex);
+    scylla_write_behind_executors.insert(write_behind_executor.get());
+  }
   
-  DBUG_RETURN(rc);
+  DBUG_RETURN(submit_write(write_behind_executor.get(), cql, statement, row, old_row,
+                           counter));
 }
 
 /**
- * Rename table
+ * Wait for the write-behind writes of the statement
+ * @return 0, or the error of the first write that failed
  */
-int ha_scylla::rename_table(const char *from, const char *to)
+int ha_scylla::flush_write_behind()
 {
-  DBUG_ENTER("ha_scylla::rename_table");
+  DBUG_ENTER("ha_scylla::flush_write_behind");
   
-  // ScyllaDB doesn't support table rename directly
-  // Would need to create new table and migrate data
-  my_printf_error(ER_ILLEGAL_HA, "ScyllaDB storage engine does not support table rename", MYF(0));
+  if (!write_behind_executor) {
+    DBUG_RETURN(0);
+  }
   
-  DBUG_RETURN(HA_ERR_WRONG_COMMAND);
+  // A killed statement stops waiting, but the executor still drains the
+  // requests already sent (bounded by their statement timeout)
+  bool ok = write_behind_executor->wait();
+  if (ok) {
+    DBUG_RETURN(0);
+  }
+  
+  scylla_write_behind_failures++;
+  if (scylla_statement_interrupted(ha_thd())) {
+    DBUG_RETURN(HA_ERR_ABORTED_BY_USER);
+  }
+  
+  my_printf_error(ER_GET_ERRNO, "CQL write-behind failed: %s",
+                  MYF(0), write_behind_executor->first_error().c_str());
+  DBUG_RETURN(HA_ERR_GENERIC);
 }
 
 /**
- * Check if query needs ALLOW FILTERING
+ * Wait for and drop the write-behind executor
  */
-bool ha_scylla::needs_allow_filtering(TABLE *table_arg)
+void ha_scylla::close_write_behind()
 {
-  // For now, always add ALLOW FILTERING to SELECT queries
-  // In production, this should be more intelligent based on the query structure
-  return true;
+  if (!write_behind_executor) {
+    return;
+  }
+  
+  {
+    std::lock_guard<std::mutex> lock(scylla_write_behind_mutex);
+    scylla_write_behind_executors.erase(write_behind_executor.get());
+  }
+  write_behind_executor.reset();
 }
 
 /**
- * Store result row to MariaDB record buffer
+ * Look up the primary key of a row about to be inserted, so the server
+ * can raise a duplicate key error, skip the row (IGNORE), or run the
+ * ON DUPLICATE KEY UPDATE clause or REPLACE's delete. The read and the
+ * write are separate requests, so a concurrent insert of the same key by
+ * another client can still be overwritten.
+ * @return 0, HA_ERR_FOUND_DUPP_KEY if the key exists, or an error
  */
-int ha_scylla::store_result_to_record(uchar *buf, size_t row_index)
+int ha_scylla::check_duplicate_key(const uchar *buf)
 {
-  DBUG_ENTER("ha_scylla::store_result_to_record");
+  DBUG_ENTER("ha_scylla::check_duplicate_key");
   
-  if (row_index >= result_set.size()) {
-    DBUG_RETURN(HA_ERR_END_OF_FILE);
+  uint index = table->s->primary_key;
+  if (index == MAX_KEY) {
+    DBUG_RETURN(0);
+  }
+  KEY *key_info = &table->key_info[index];
+  
+  const ScyllaStatementTemplate &tpl =
+    share->get_lookup_template(table, index, key_info->user_defined_key_parts);
+  CassStatement *statement = bind_template(tpl, buf);
+  std::string cql = tpl.cql;
+  if (!statement) {
+    std::vector<uchar> key(key_info->key_length);
+    key_copy(key.data(), buf, key_info, key_info->key_length);
+    ScyllaQueryBuilder builder;
+    std::string where_clause = builder.build_where_from_key(table, key.data(), HA_WHOLE_KEY);
+    cql = builder.build_select_cql(table, options->keyspace, options->table,
+                                   true, where_clause);
   }
   
-  MY_BITMAP *old_map = table->write_set;
-  dbug_tmp_use_all_columns(table, &table->write_set);
+  // Not from the row cache: a stale miss would hide the duplicate
+  int rc = execute_select(cql, statement, ScyllaClusterOptions::PROFILE_OLTP);
+  if (rc) {
+    DBUG_RETURN(rc);
+  }
   
-  const std::vector<std::string> &row = result_set[row_index];
+  bool found = !result_set.empty();
+  release_result_memory();
+  result_set.reset();
   
-  if (verbose_logging && global_system_variables.log_warnings >= 3) {
-    sql_print_information("Scylla: Table %s.%s: store_result_to_record row %zu, buf=%p, table->record[0]=%p, offset=%lld",
-                         keyspace_name.c_str(), table_name.c_str(), row_index, 
-                         buf, table->record[0], (long long)(buf - table->record[0]));
-    sql_print_information("Scylla: Table %s.%s: record layout: null_bytes=%u, null_fields=%u, reclength=%u, null_flags=%p",
-                         keyspace_name.c_str(), table_name.c_str(),
-                         (unsigned)table->s->null_bytes, (unsigned)table->s->null_fields,
-                         (unsigned)table->s->reclength, table->null_flags);
+  if (found) {
+    errkey = index;
+    DBUG_RETURN(HA_ERR_FOUND_DUPP_KEY);
   }
   
-  // Move all fields to point to the provided buffer instead of table->record[0]
-  my_ptrdiff_t offset = buf - table->record[0];
-  if (offset) {
-    for (uint i = 0; i < table->s->fields; i++) {
-      table->field[i]->move_field_offset(offset);
-    }
+  DBUG_RETURN(0);
+}
+
+/**
+ * Follow the duplicate key handling the server asks for
+ */
+int ha_scylla::extra(enum ha_extra_function operation)
+{
+  DBUG_ENTER("ha_scylla::extra");
+  
+  switch (operation) {
+    case HA_EXTRA_WRITE_CAN_REPLACE:
+      write_can_replace = true;
+      break;
+    case HA_EXTRA_WRITE_CANNOT_REPLACE:
+      write_can_replace = false;
+      break;
+    default:
+      // HA_EXTRA_IGNORE_DUP_KEY and HA_EXTRA_INSERT_WITH_UPDATE need
+      // nothing: IGNORE and ON DUPLICATE KEY UPDATE act on
+      // HA_ERR_FOUND_DUPP_KEY, which only scylla_duplicate_keys=check reports
+      break;
   }
   
-  // Clear the buffer to zero (safe for all types)
-  memset(buf, 0, table->s->reclength);
+  DBUG_RETURN(0);
+}
+
+/**
+ * Start a multi-row insert; INSERTs are pipelined when
+ * scylla_bulk_insert_concurrency allows more than one in flight, except
+ * when every row is checked for a duplicate key: the check must see the
+ * rows inserted before it
+ */
+void ha_scylla::start_bulk_insert(ha_rows rows, uint flags)
+{
+  DBUG_ENTER("ha_scylla::start_bulk_insert");
   
-  // Build a map of column names to their positions in the result set
-  // Use lowercase for case-insensitive matching
-  std::map<std::string, size_t> column_map;
-  for (size_t i = 0; i < column_names.size() && i < row.size(); i++) {
-    std::string col_name_lower = column_names[i];
-    std::transform(col_name_lower.begin(), col_name_lower.end(), col_name_lower.begin(), ::tolower);
-    column_map[col_name_lower] = i;
-  }
+  THD *thd = ha_thd();
+  uint concurrency = THDVAR(thd, bulk_insert_concurrency);
+  bool check = options->duplicate_keys == SCYLLA_DUPLICATE_KEY_CHECK && !write_can_replace;
+  bulk_concurrency = (rows != 1 && concurrency > 1 && !check) ? concurrency : 0;
+  bulk_batch_rows = THDVAR(thd, bulk_batch_rows) > 1 ? THDVAR(thd, bulk_batch_rows) : 0;
+  bulk_batches.set_limits(bulk_batch_rows, BULK_BATCH_MAX_BYTES);
   
-  // Map fields by name, not by position
-  for (uint i = 0; i < table->s->fields; i++) {
-    Field *field = table->field[i];
-    std::string field_name(field->field_name.str, field->field_name.length);
-    // Debug: print offset and raw bytes for animal_id
-    if (verbose_logging && global_system_variables.log_warnings >= 3) {
-      sql_print_information("Scylla: Table %s.%s: Field '%s' offset in record: %ld, field->ptr=%p, buf=%p",
-        keyspace_name.c_str(), table_name.c_str(), field_name.c_str(),
-        (long)(field->ptr - buf), field->ptr, buf);
-      if ((i == 0 || i == 1) && field->null_ptr) {
-        sql_print_information("Scylla: Table %s.%s: Field '%s' null_ptr=%p (offset %ld), null_bit=0x%02x",
-          keyspace_name.c_str(), table_name.c_str(), field_name.c_str(),
-          field->null_ptr, (long)((uchar*)field->null_ptr - buf), (unsigned)field->null_bit);
-      }
-      if (field_name == "animal_id") {
-        unsigned char *p = (unsigned char*)field->ptr;
-        char hex[32];
-        snprintf(hex, sizeof(hex), "%02x %02x %02x %02x", p[0], p[1], p[2], p[3]);
-        sql_print_information("Scylla: Table %s.%s: animal_id raw bytes: %s", keyspace_name.c_str(), table_name.c_str(), hex);
-      }
-    }
-    // Convert to lowercase for case-insensitive lookup
-    std::string field_name_lower = field_name;
-    std::transform(field_name_lower.begin(), field_name_lower.end(), field_name_lower.begin(), ::tolower);
-    auto it = column_map.find(field_name_lower);
-    if (it != column_map.end()) {
-      size_t col_idx = it->second;
-      if (verbose_logging && global_system_variables.log_warnings >= 3) {
-        sql_print_information("Scylla: Table %s.%s: Mapping field '%s' -> column[%zu] = '%s', field->ptr=%p",
-                             keyspace_name.c_str(), table_name.c_str(),
-                             field_name.c_str(), col_idx, row[col_idx].c_str(), field->ptr);
-      }
-      if (row[col_idx].empty() || row[col_idx] == "NULL") {
-        field->set_null();
-      } else {
-        field->set_notnull();
-        ScyllaTypes::store_field_value(field, row[col_idx]);
-        // Debug: For integer fields, read back the value we just stored
-        if (verbose_logging && global_system_variables.log_warnings >= 3 && 
-            (field->type() == MYSQL_TYPE_LONG || field->type() == MYSQL_TYPE_LONGLONG)) {
-          longlong stored_val = field->val_int();
-          sql_print_information("Scylla: Table %s.%s: Stored integer value for '%s': wrote '%s', read back %lld",
-                               keyspace_name.c_str(), table_name.c_str(),
-                               field_name.c_str(), row[col_idx].c_str(), stored_val);
-        }
-      }
-      if (verbose_logging && global_system_variables.log_warnings >= 3) {
-        unsigned char *p = (unsigned char*)buf;
-        char hex[32];
-        snprintf(hex, sizeof(hex), "%02x %02x %02x %02x %02x %02x %02x %02x",
-                 p[0], p[1], p[2], p[3], p[4], p[5], p[6], p[7]);
-        sql_print_information("Scylla: Table %s.%s: Row bytes after field '%s': %s",
-                             keyspace_name.c_str(), table_name.c_str(),
-                             field_name.c_str(), hex);
-      }
-    } else {
-      // Column not found in result set - set to NULL
-      if (verbose_logging && global_system_variables.log_warnings >= 3) {
-        sql_print_information("Scylla: Table %s.%s: Field '%s' not found in result columns",
-                             keyspace_name.c_str(), table_name.c_str(), field_name.c_str());
-      }
-      field->set_null();
-    }
-  }
+  DBUG_VOID_RETURN;
+}
+
+/**
+ * Wait for the pipelined INSERTs of a multi-row insert
+ */
+int ha_scylla::end_bulk_insert()
+{
+  DBUG_ENTER("ha_scylla::end_bulk_insert");
   
-  // Final debug: Check what animal_id actually contains in the buffer before returning
-  if (verbose_logging && global_system_variables.log_warnings >= 3) {
-    for (uint i = 0; i < table->s->fields; i++) {
-      Field *field = table->field[i];
-      std::string field_name(field->field_name.str, field->field_name.length);
-      if (field_name == "animal_id" || field_name == "habitat_id" || field_name == "feeding_id") {
-        longlong final_val = field->val_int();
-        
-        sql_print_information("Scylla: Table %s.%s: Final check before return: '%s' = %lld (in buffer %p)",
-                             keyspace_name.c_str(), table_name.c_str(),
-                             field_name.c_str(), final_val, buf);
-      }
-    }
+  int rc = finish_bulk_writes(&share->rows_written);
+  if (rc) {
+    DBUG_RETURN(rc);
   }
   
-  // Restore field pointers to table->record[0] if we moved them
-  if (offset) {
-    for (uint i = 0; i < table->s->fields; i++) {
-      table->field[i]->move_field_offset(-offset);
-    }
+  if (options->verbose && global_system_variables.log_warnings >= 3) {
+    sql_print_information("Scylla: Table %s.%s: Bulk insert completed",
+                         options->keyspace.c_str(), options->table.c_str());
   }
   
-  dbug_tmp_restore_column_map(&table->write_set, old_map);
-  
   DBUG_RETURN(0);
 }
 
 /**
- * Write row
+ * Start a multi-row delete; DELETEs are pipelined and batched like the
+ * INSERTs of a bulk insert. Rows to delete come from a scan that is
+ * already buffered, so deferring the deletes does not affect it.
+ * @return false if deletes are deferred until end_bulk_delete()
  */
-int ha_scylla::write_row(const uchar *buf)
+bool ha_scylla::start_bulk_delete()
 {
-  DBUG_ENTER("ha_scylla::write_row");
+  DBUG_ENTER("ha_scylla::start_bulk_delete");
   
-  ScyllaQueryBuilder builder;
-  std::string cql = builder.build_insert_cql(table, buf, keyspace_name, table_name);
-  
-  if (verbose_logging && global_system_variables.log_warnings >= 3) {
-    sql_print_information("Scylla: Table %s.%s: Executing INSERT %s",
-                         keyspace_name.c_str(), table_name.c_str(), cql.c_str());
+  THD *thd = ha_thd();
+  uint concurrency = THDVAR(thd, bulk_insert_concurrency);
+  if (concurrency <= 1) {
+    DBUG_RETURN(true);
   }
   
-  int rc = execute_cql(cql);
+  bulk_delete = true;
+  bulk_concurrency = concurrency;
+  bulk_batch_rows = THDVAR(thd, bulk_batch_rows) > 1 ? THDVAR(thd, bulk_batch_rows) : 0;
+  bulk_batches.set_limits(bulk_batch_rows, BULK_BATCH_MAX_BYTES);
   
-  if (rc == 0 && verbose_logging && global_system_variables.log_warnings >= 3) {
-    sql_print_information("Scylla: Table %s.%s: Successfully INSERTed 1 row",
-                         keyspace_name.c_str(), table_name.c_str());
-  }
+  DBUG_RETURN(false);
+}
+
+/**
+ * Wait for the deferred DELETEs of a multi-row delete
+ */
+int ha_scylla::end_bulk_delete()
+{
+  DBUG_ENTER("ha_scylla::end_bulk_delete");
   
-  DBUG_RETURN(rc);
+  bulk_delete = false;
+  DBUG_RETURN(finish_bulk_writes(&share->rows_deleted));
 }
 
 /**
@@ -664,20 +3154,35 @@ int ha_scylla::update_row(const uchar *old_data, const uchar *new_data)
 {
   DBUG_ENTER("ha_scylla::update_row");
   
-  ScyllaQueryBuilder builder;
-  std::string cql = builder.build_update_cql(table, old_data, new_data, 
-                                             keyspace_name, table_name);
+  // SET binds the new values, the key condition addresses the old row
+  const ScyllaStatementTemplate &tpl = share->get_update_template(table, table->write_set);
+  CassStatement *statement = bind_template(tpl, new_data, old_data);
+  std::string cql = tpl.cql;
+  if (!statement) {
+    ScyllaQueryBuilder builder;
+    cql = builder.build_update_cql(table, old_data, new_data,
+                                   options->keyspace, options->table);
+  }
   
-  if (verbose_logging && global_system_variables.log_warnings >= 3) {
+  if (options->verbose && global_system_variables.log_warnings >= 3) {
     sql_print_information("Scylla: Table %s.%s: Executing UPDATE %s",
-                         keyspace_name.c_str(), table_name.c_str(), cql.c_str());
+                         options->keyspace.c_str(), options->table.c_str(), cql.c_str());
   }
   
-  int rc = execute_cql(cql);
+  if (options->write_behind) {
+    DBUG_RETURN(submit_write_behind(cql, statement, new_data, old_data, &share->rows_updated));
+  }
+  
+  int rc = execute_cql(cql, statement, old_data);
+  invalidate_cached_row(old_data);
+  invalidate_cached_row(new_data);
+  if (rc == 0) {
+    share->rows_updated++;
+  }
   
-  if (rc == 0 && verbose_logging && global_system_variables.log_warnings >= 3) {
+  if (rc == 0 && options->verbose && global_system_variables.log_warnings >= 3) {
     sql_print_information("Scylla: Table %s.%s: Successfully UPDATEd 1 row",
-                         keyspace_name.c_str(), table_name.c_str());
+                         options->keyspace.c_str(), options->table.c_str());
   }
   
   DBUG_RETURN(rc);
@@ -690,19 +3195,35 @@ int ha_scylla::delete_row(const uchar *buf)
 {
   DBUG_ENTER("ha_scylla::delete_row");
   
-  ScyllaQueryBuilder builder;
-  std::string cql = builder.build_delete_cql(table, buf, keyspace_name, table_name);
+  const ScyllaStatementTemplate &tpl = share->delete_template;
+  CassStatement *statement = bind_template(tpl, buf);
+  std::string cql = tpl.cql;
+  if (!statement) {
+    ScyllaQueryBuilder builder;
+    cql = builder.build_delete_cql(table, buf, options->keyspace, options->table);
+  }
   
-  if (verbose_logging && global_system_variables.log_warnings >= 3) {
+  if (options->verbose && global_system_variables.log_warnings >= 3) {
     sql_print_information("Scylla: Table %s.%s: Executing DELETE %s",
-                         keyspace_name.c_str(), table_name.c_str(), cql.c_str());
+                         options->keyspace.c_str(), options->table.c_str(), cql.c_str());
   }
   
-  int rc = execute_cql(cql);
+  if (bulk_delete) {
+    DBUG_RETURN(submit_bulk_write(buf, cql, statement, &share->rows_deleted));
+  }
+  if (options->write_behind) {
+    DBUG_RETURN(submit_write_behind(cql, statement, buf, NULL, &share->rows_deleted));
+  }
+  
+  int rc = execute_cql(cql, statement, buf);
+  invalidate_cached_row(buf);
+  if (rc == 0) {
+    share->rows_deleted++;
+  }
   
-  if (rc == 0 && verbose_logging && global_system_variables.log_warnings >= 3) {
+  if (rc == 0 && options->verbose && global_system_variables.log_warnings >= 3) {
     sql_print_information("Scylla: Table %s.%s: Successfully DELETEd 1 row",
-                         keyspace_name.c_str(), table_name.c_str());
+                         options->keyspace.c_str(), options->table.c_str());
   }
   
   DBUG_RETURN(rc);
@@ -717,25 +3238,29 @@ int ha_scylla::rnd_init(bool scan)
   
   scan_active = scan;
   current_position = 0;
-  result_set.clear();
   
+  // rnd_init(false) precedes rnd_pos() calls, which address rows buffered
+  // by the previous scan, so the buffer is only replaced for a new scan
   if (scan) {
-    ScyllaQueryBuilder builder;
-    std::string cql = builder.build_select_cql(table, keyspace_name, table_name, true);
+    const std::string &cql = scan_bypasses_cache() ? share->select_all_bypass_cql
+                                                   : share->select_all_cql;
     
-    if (verbose_logging && global_system_variables.log_warnings >= 3) {
+    if (options->verbose && global_system_variables.log_warnings >= 3) {
       sql_print_information("Scylla: Table %s.%s: Executing SELECT %s",
-                           keyspace_name.c_str(), table_name.c_str(), cql.c_str());
+                           options->keyspace.c_str(), options->table.c_str(), cql.c_str());
     }
     
-    int rc = execute_cql(cql);
+    int rc = execute_select(cql, NULL, ScyllaClusterOptions::PROFILE_SCAN);
     if (rc) {
       DBUG_RETURN(rc);
     }
     
-    if (verbose_logging && global_system_variables.log_warnings >= 3) {
+    // A full scan is the only exact row count the optimizer gets
+    share->estimated_rows = result_set.size();
+    
+    if (options->verbose && global_system_variables.log_warnings >= 3) {
       sql_print_information("Scylla: Table %s.%s: Successfully SELECTed %zu rows",
-                           keyspace_name.c_str(), table_name.c_str(), result_set.size());
+                           options->keyspace.c_str(), options->table.c_str(), result_set.size());
     }
   }
   
@@ -755,6 +3280,9 @@ int ha_scylla::rnd_next(uchar *buf)
   
   int rc = store_result_to_record(buf, current_position);
   current_position++;
+  if (rc == 0) {
+    share->rows_read++;
+  }
   
   DBUG_RETURN(rc);
 }
@@ -831,18 +3359,95 @@ int ha_scylla::index_read_map(uchar *buf, const uchar *key,
 {
   DBUG_ENTER("ha_scylla::index_read_map");
   
-  // Build WHERE clause from key
-  ScyllaQueryBuilder builder;
-  std::string where_clause = builder.build_where_from_key(table, key, keypart_map);
-  std::string cql = builder.build_select_cql(table, keyspace_name, table_name, 
-                                             true, where_clause);
+  uint index = (active_index != MAX_KEY) ? active_index : table->s->primary_key;
+  KEY *key_info = &table->key_info[index];
+  uint key_parts = 0;
+  uint key_length = 0;
+  while (key_parts < key_info->user_defined_key_parts &&
+         (keypart_map & ((key_part_map) 1 << key_parts))) {
+    key_length += key_info->key_part[key_parts].store_length;
+    key_parts++;
+  }
   
-  result_set.clear();
   current_position = 0;
   
-  int rc = execute_cql(cql);
-  if (rc) {
-    DBUG_RETURN(rc);
+  // Exact full primary key reads may be served from the row cache or by an
+  // identical read in flight, except for statements that go on to write
+  // the row
+  bool point_read = share && index == table->s->primary_key &&
+                    key_parts == key_info->user_defined_key_parts &&
+                    find_flag == HA_READ_KEY_EXACT && lock.type < TL_WRITE_ALLOW_WRITE;
+  std::string read_key;
+  uint64_t cache_ticket = 0;
+  long cache_ttl = point_read ? row_cache_ttl() : 0;
+  ScyllaRowCache::EntryPtr cached;
+  if (point_read && (cache_ttl > 0 || scylla_coalesce_reads)) {
+    read_key = share->cache_key(key, key_length);
+  }
+  if (cache_ttl > 0) {
+    cached = scylla_row_cache.lookup(read_key, &cache_ticket);
+  }
+  
+  // Without a cached copy, wait for a concurrent read of the key or lead one.
+  // If the leader fails, its followers read on their own. Only reads at the
+  // table's consistency share a flight, so a session or hint asking for a
+  // stronger level never gets a weaker read's result
+  ScyllaSingleFlight::CallPtr flight;
+  bool leader = false;
+  if (!cached && !read_key.empty() && scylla_coalesce_reads &&
+      statement_consistency(false) == options->read_consistency) {
+    flight = scylla_single_flight.join(read_key, &leader);
+    if (!leader) {
+      cached = scylla_single_flight.wait(flight);
+    }
+  }
+  
+  int rc;
+  if (cached) {
+    load_cached_result(*cached);
+  } else {
+    // Unpack the key into the row buffer so its fields bind like a row
+    key_restore(buf, key, key_info, key_length);
+    
+    const ScyllaStatementTemplate &tpl = share->get_lookup_template(table, index, key_parts);
+    CassStatement *statement = bind_template(tpl, buf);
+    std::string cql = tpl.cql;
+    if (!statement) {
+      // Build WHERE clause from key
+      ScyllaQueryBuilder builder;
+      std::string where_clause = builder.build_where_from_key(table, key, keypart_map);
+      cql = builder.build_select_cql(table, options->keyspace, options->table,
+                                     true, where_clause);
+    }
+    
+    // Anything but an exact primary key lookup may read many rows
+    bool key_lookup = index == table->s->primary_key &&
+                      key_parts == key_info->user_defined_key_parts &&
+                      find_flag == HA_READ_KEY_EXACT;
+    rc = execute_select(cql, statement, key_lookup ? ScyllaClusterOptions::PROFILE_OLTP
+                                                   : ScyllaClusterOptions::PROFILE_SCAN);
+    
+    std::shared_ptr<ScyllaRowCache::Entry> entry;
+    if (rc == 0 && !read_key.empty() && !result_set.is_spilled()) {
+      entry = std::make_shared<ScyllaRowCache::Entry>();
+      entry->column_names = column_names;
+      for (size_t i = 0; i < result_set.size(); i++) {
+        entry->rows.push_back(*result_set.get_row(i));
+      }
+      if (cache_ttl > 0) {
+        scylla_row_cache.insert(read_key, entry, (unsigned long) cache_ttl, cache_ticket,
+                                share->cache_tag(column_names,
+                                                 entry->rows.empty() ? NULL : &entry->rows[0]));
+      }
+    }
+    
+    if (leader) {
+      scylla_single_flight.complete(read_key, flight, entry);
+    }
+    
+    if (rc) {
+      DBUG_RETURN(rc);
+    }
   }
   
   if (result_set.empty()) {
@@ -851,6 +3456,9 @@ int ha_scylla::index_read_map(uchar *buf, const uchar *key,
   
   rc = store_result_to_record(buf, 0);
   current_position = 1;
+  if (rc == 0) {
+    share->rows_read++;
+  }
   
   DBUG_RETURN(rc);
 }
@@ -905,7 +3513,9 @@ int ha_scylla::info(uint flag)
   }
   
   if (flag & HA_STATUS_VARIABLE) {
-    stats.records = 10000; // Estimate
+    // Row count seen by the last full scan, or a guess before any scan
+    ha_rows estimate = share ? (ha_rows) share->estimated_rows : 0;
+    stats.records = estimate ? estimate : 10000;
     stats.deleted = 0;
     stats.data_file_length = 0;
     stats.index_file_length = 0;
@@ -919,12 +3529,44 @@ int ha_scylla::info(uint flag)
   DBUG_RETURN(0);
 }
 
+/**
+ * Reset handler state at the end of a statement
+ */
+int ha_scylla::reset()
+{
+  DBUG_ENTER("ha_scylla::reset");
+  
+  // Free buffered rows and any spill file; positions do not outlive
+  // the statement
+  release_result_memory();
+  result_set.reset();
+  current_position = 0;
+  write_can_replace = false;
+  
+  // Under LOCK TABLES the table is not unlocked between statements; the
+  // server ignores errors here, so failures can only be logged
+  if (write_behind_executor && !write_behind_executor->wait()) {
+    scylla_write_behind_failures++;
+    sql_print_warning("Scylla: Table %s.%s: Write-behind writes failed: %s",
+                      options->keyspace.c_str(), options->table.c_str(),
+                      write_behind_executor->first_error().c_str());
+  }
+  
+  DBUG_RETURN(0);
+}
+
 /**
  * External lock
  */
 int ha_scylla::external_lock(THD *thd, int lock_type)
 {
   DBUG_ENTER("ha_scylla::external_lock");
+  
+  // Write-behind writes are acknowledged when the statement releases the table
+  if (lock_type == F_UNLCK) {
+    DBUG_RETURN(flush_write_behind());
+  }
+  
   DBUG_RETURN(0);
 }
 
@@ -21,17 +21,204 @@
 #include <my_global.h>
 #include <handler.h>
 #include <table.h>
+#include <atomic>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
 #include "scylla_connection.h"
+#include "scylla_rate_limiter.h"
+#include "scylla_batch_builder.h"
 #include "scylla_query.h"
+#include "scylla_result_buffer.h"
+#include "scylla_row_cache.h"
+#include "scylla_cdc.h"
 
 // Forward declarations
 class ScyllaConnection;
 class ScyllaQueryBuilder;
 
+/**
+ * Whether full scans skip ScyllaDB's row cache
+ */
+enum scylla_bypass_cache_mode {
+  SCYLLA_BYPASS_CACHE_AUTO,   // Above scylla_bypass_cache_rows
+  SCYLLA_BYPASS_CACHE_ON,
+  SCYLLA_BYPASS_CACHE_OFF
+};
+
+/**
+ * How INSERTs treat an existing row with the same primary key
+ */
+enum scylla_duplicate_key_mode {
+  SCYLLA_DUPLICATE_KEY_UPSERT,  // Overwrite it, as CQL INSERT does
+  SCYLLA_DUPLICATE_KEY_CHECK    // Report it to the server, reading the key first
+};
+
+/**
+ * ScyllaTableOptions - Connection and mapping options of a table
+ *
+ * Filled from the global defaults and the table COMMENT, e.g.
+ * COMMENT='scylla_hosts=host1,host2;scylla_keyspace=ks;scylla_table=tbl'
+ */
+struct ScyllaTableOptions
+{
+  std::string hosts;      // Contact points
+  int port;               // Native transport port
+  std::string keyspace;   // ScyllaDB keyspace name
+  std::string table;      // ScyllaDB table name
+  bool verbose;           // Verbose logging for this table
+  long cache_ttl;         // Row cache TTL in ms, -1 uses scylla_row_cache_ttl
+  CassConsistency read_consistency;    // CASS_CONSISTENCY_UNKNOWN when not set
+  CassConsistency write_consistency;
+  CassConsistency serial_consistency;
+  ScyllaClusterOptions cluster;        // Driver settings of the connection
+  ScyllaClusterOptions::Profile execution_profile;  // PROFILE_COUNT = by statement type
+  std::string scan_username;          // Role of scans and bulk writes, empty = same session
+  std::string scan_password;
+  scylla_bypass_cache_mode bypass_cache;  // Of full scans
+  ulonglong scan_rows_per_sec;        // Table rate limits, 0 = unlimited
+  ulonglong scan_bytes_per_sec;
+  ulonglong write_rows_per_sec;
+  ulonglong write_bytes_per_sec;
+  uint write_behind;                  // Writes in flight of write-behind mode, 0 = off
+  scylla_duplicate_key_mode duplicate_keys;
+  
+  ScyllaTableOptions();
+  
+  /**
+   * Reset to the global defaults, then apply the table comment
+   * @param comment Table comment (may be NULL)
+   * @param name MariaDB table path, used when scylla_table is not given
+   */
+  void init(const char *comment, const char *name);
+  
+  /**
+   * Apply key=value pairs separated by ';'
+   */
+  void parse_comment(const char *comment);
+};
+
+/**
+ * Scylla_share - State shared by all handler instances of one table
+ *
+ * Created once per TABLE_SHARE, so opening another handler on the same
+ * table does not re-parse options, reconnect or reload the schema.
+ */
+class Scylla_share : public Handler_share
+{
+private:
+  std::mutex prepared_mutex;
+  std::map<std::string, const CassPrepared*> prepared;  // Cached by CQL text
+  std::mutex templates_mutex;
+  std::map<std::string, ScyllaStatementTemplate> templates;  // Built on demand
+  
+  int load_schema(TABLE *table);
+  
+public:
+  THR_LOCK lock;                          // MariaDB lock object
+  bool initialized;
+  ScyllaTableOptions options;
+  std::shared_ptr<ScyllaConnection> conn; // Shared cluster connection
+  
+  // ScyllaDB-side schema
+  std::vector<std::string> partition_key;      // Partition key columns
+  std::vector<std::string> clustering_key;     // Clustering columns
+  std::vector<std::string> indexes;            // Secondary index names
+  std::vector<size_t> partition_key_params;    // INSERT markers of the partition key
+  
+  // Precomputed CQL fragments
+  std::string qualified_name;             // keyspace.table
+  std::string column_list;                // All columns in field order
+  std::string select_all_cql;             // Full table scan statement
+  std::string select_all_bypass_cql;      // The same, skipping ScyllaDB's cache
+  ScyllaStatementTemplate insert_template; // INSERT binding all fields
+  ScyllaStatementTemplate delete_template; // DELETE by primary key
+  
+  // Statistics
+  std::atomic<ulonglong> rows_read;
+  std::atomic<ulonglong> rows_written;
+  std::atomic<ulonglong> rows_updated;
+  std::atomic<ulonglong> rows_deleted;
+  std::atomic<ha_rows> estimated_rows;    // Row count of the last full scan
+  
+  // Rate limits of the table, on top of the global ones
+  ScyllaRateLimiter scan_rows_limiter;
+  ScyllaRateLimiter scan_bytes_limiter;
+  ScyllaRateLimiter write_rows_limiter;
+  ScyllaRateLimiter write_bytes_limiter;
+  
+  // Row cache keys include the epoch; a new epoch orphans all cached rows
+  std::atomic<ulonglong> cache_epoch;
+  
+  // CDC consumer invalidating cached rows changed by other clients
+  std::shared_ptr<ScyllaCdcConsumer> cdc;
+  uint64_t cdc_subscription;
+  
+  Scylla_share();
+  ~Scylla_share();
+  
+  /**
+   * Parse options, connect and load the table schema
+   * @param table Opened MariaDB table
+   * @param name MariaDB table path
+   * @return 0 or HA_ERR_* code
+   */
+  int init(TABLE *table, const char *name);
+  
+  /**
+   * Get a prepared statement, preparing it on first use
+   * @param cql CQL statement with bind markers
+   * @param param_count Number of bind markers whose types must be bindable
+   * @return Prepared statement owned by the share, or NULL if it cannot be
+   *         prepared or bound (remembered, callers fall back to CQL text)
+   */
+  const CassPrepared* get_prepared(const std::string &cql, size_t param_count = 0);
+  
+  /**
+   * Build the row cache key of a primary key value
+   * @param key Primary key image (as produced by key_copy())
+   * @param length Key image length
+   * @return Cache key
+   */
+  std::string cache_key(const uchar *key, uint length) const;
+  
+  /**
+   * Build the row cache tag of a lookup result, naming the row by its CQL
+   * primary key values the way CDC reports them
+   * @param column_names Result columns
+   * @param row First result row, NULL if the key was not found
+   * @return Tag, empty if the result lacks a key column
+   */
+  std::string cache_tag(const std::vector<std::string> &column_names,
+                        const std::vector<std::string> *row) const;
+  
+  /**
+   * Drop cached rows changed by other clients
+   * @param keys Primary key values of the changed rows, as reported by CDC
+   */
+  void invalidate_changed_rows(const std::vector<std::vector<std::string>> &keys);
+  
+  /**
+   * Get the UPDATE template for the set of written fields
+   * @param table Opened MariaDB table
+   * @param write_set Fields written by the statement
+   * @return Template owned by the share
+   */
+  const ScyllaStatementTemplate &get_update_template(TABLE *table, const MY_BITMAP *write_set);
+  
+  /**
+   * Get the SELECT template for a prefix of an index
+   * @param table Opened MariaDB table
+   * @param index Index number
+   * @param key_parts Number of leading key parts
+   * @return Template owned by the share
+   */
+  const ScyllaStatementTemplate &get_lookup_template(TABLE *table, uint index, uint key_parts);
+};
+
 /**
  * ha_scylla - MariaDB storage engine handler for ScyllaDB
  * 
@@ -42,31 +229,87 @@ class ha_scylla: public handler
 {
 private:
   THR_LOCK_DATA lock;                    // MariaDB lock structure
-  THR_LOCK thr_lock;                     // MariaDB lock object
-  std::shared_ptr<ScyllaConnection> conn; // Connection to ScyllaDB cluster
-  std::string keyspace_name;              // ScyllaDB keyspace name
-  std::string table_name;                 // ScyllaDB table name
+  Scylla_share *share;                   // Shared per-table state
+  std::shared_ptr<ScyllaConnection> conn; // Cluster connection (share's once opened)
+  std::shared_ptr<ScyllaConnection> scan_conn; // Session of the scan role, if configured
+  ScyllaTableOptions ddl_options;         // Options for create/drop without open()
+  const ScyllaTableOptions *options;      // share->options once opened
   
   // Query results
   std::vector<std::string> column_names;  // Column names from CQL result
-  std::vector<std::vector<std::string>> result_set;
+  std::vector<int> field_columns;         // Result column of each field, -1 if absent
+  ScyllaResultBuffer result_set;          // Rows, spilled to disk past budget
   size_t current_position;
   bool scan_active;
   
-  // Table metadata
-  std::string primary_key_column;
-  std::vector<std::string> clustering_columns;
+  // Result memory charged to the session (see account_result_memory())
+  longlong accounted_memory;
+  THD *accounted_thd;
+  
+  // Consistency hints of the current query (see apply_consistency())
+  longlong hints_query_id;
+  CassConsistency hint_consistency;
+  CassConsistency hint_serial_consistency;
+  
+  // Pipelined INSERTs between start_bulk_insert() and end_bulk_insert(),
+  // and DELETEs between start_bulk_delete() and end_bulk_delete()
+  uint bulk_concurrency;                  // 0 when rows are written one by one
+  uint bulk_batch_rows;                   // 0 when rows are not batched
+  bool bulk_delete;
+  std::unique_ptr<ScyllaExecutor> bulk_executor;
+  ScyllaBatchBuilder bulk_batches;        // Rows waiting for a full batch
+  
+  // Set by HA_EXTRA_WRITE_CAN_REPLACE: REPLACE may overwrite the old row
+  // with a single upsert instead of deleting it first
+  bool write_can_replace;
   
-  // Connection parameters stored during table creation
-  std::string scylla_hosts;
-  bool verbose_logging;  // Enable verbose logging for this table
-  int scylla_port;
+  // Write-behind writes, acknowledged by flush_write_behind()
+  std::unique_ptr<ScyllaExecutor> write_behind_executor;
   
   // Helper methods
+  Scylla_share *get_share();
   int connect_to_scylla();
-  int parse_table_comment(const char *comment);
+  bool scan_bypasses_cache();
+  bool throttle_scan(ulonglong bytes);
+  bool throttle_write(ulonglong bytes);
+  ScyllaRetryPolicy write_retry_policy() const;
+  const std::shared_ptr<ScyllaConnection> &workload_connection(ScyllaClusterOptions::Profile profile);
+  void map_result_columns();
   int create_scylla_table(const char *name, TABLE *form);
-  int execute_cql(const std::string &cql);
+  CassStatement *bind_template(const ScyllaStatementTemplate &tpl, const uchar *buf,
+                               const uchar *key_buf = NULL);
+  int prepare_statement(CassStatement *statement, bool write,
+                        ScyllaClusterOptions::Profile profile, bool row_write = false);
+  void apply_statement_deadline(CassStatement *statement,
+                                ScyllaClusterOptions::Profile profile);
+  int64_t pin_write_timestamp(CassStatement *statement);
+  CassConsistency statement_consistency(bool write);
+  void apply_consistency(CassStatement *statement, bool write);
+  bool partition_token(const uchar *row, int64_t *token);
+  int check_duplicate_key(const uchar *buf);
+  int execute_cql(const std::string &cql, CassStatement *statement = NULL,
+                  const uchar *row = NULL);
+  ScyllaExecutor *new_write_executor(size_t max_in_flight);
+  int submit_write(ScyllaExecutor *executor, const std::string &cql, CassStatement *statement,
+                   const uchar *row, const uchar *old_row, std::atomic<ulonglong> *counter);
+  int submit_bulk_write(const uchar *buf, const std::string &cql, CassStatement *statement,
+                        std::atomic<ulonglong> *counter);
+  int send_batch(ScyllaBatchBuilder::Batch &rows, std::atomic<ulonglong> *counter);
+  int finish_bulk_writes(std::atomic<ulonglong> *counter);
+  int submit_write_behind(const std::string &cql, CassStatement *statement,
+                          const uchar *row, const uchar *old_row,
+                          std::atomic<ulonglong> *counter);
+  int flush_write_behind();
+  void close_write_behind();
+  int execute_select(const std::string &cql, CassStatement *statement = NULL,
+                     ScyllaClusterOptions::Profile profile = ScyllaClusterOptions::PROFILE_OLTP);
+  long row_cache_ttl() const;
+  std::string row_cache_key(const uchar *record);
+  std::string invalidation_key(const uchar *record);
+  void invalidate_cached_row(const uchar *record);
+  void load_cached_result(const ScyllaRowCache::Entry &entry);
+  int account_result_memory(bool force);
+  void release_result_memory();
   int store_result_to_record(uchar *buf, size_t row_index);
   bool needs_allow_filtering(TABLE *table_arg);
   
@@ -98,6 +341,11 @@ public:
   int write_row(const uchar *buf) override;
   int update_row(const uchar *old_data, const uchar *new_data) override;
   int delete_row(const uchar *buf) override;
+  void start_bulk_insert(ha_rows rows, uint flags) override;
+  int end_bulk_insert() override;
+  int extra(enum ha_extra_function operation) override;
+  bool start_bulk_delete() override;
+  int end_bulk_delete() override;
   
   // Scanning operations
   int index_init(uint idx, bool sorted) override;
@@ -117,6 +365,7 @@ public:
   
   // Table info
   int info(uint flag) override;
+  int reset() override;
   int external_lock(THD *thd, int lock_type) override;
   
   // Transaction support (basic - ScyllaDB is eventually consistent)
@@ -0,0 +1,620 @@
+/*
+   Copyright (c) 2025, MariaDB ScyllaDB Storage Engine
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; version 2 of the License.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+#include "scylla_async.h"
+#include "scylla_connection.h"
+#include "scylla_concurrency_limit.h"
+#include <algorithm>
+#include <random>
+#include <thread>
+
+/*
+ * ScyllaWait implementation
+ */
+std::atomic<ScyllaWait::Hook> ScyllaWait::begin_hook(NULL);
+std::atomic<ScyllaWait::Hook> ScyllaWait::end_hook(NULL);
+std::atomic<ScyllaWait::InterruptHook> ScyllaWait::interrupt_hook(NULL);
+thread_local unsigned int ScyllaWait::depth = 0;
+
+/**
+ * Install the wait hooks
+ */
+void ScyllaWait::set_hooks(Hook begin, Hook end)
+{
+  begin_hook = begin;
+  end_hook = end;
+}
+
+/**
+ * Install the interrupt hook
+ */
+void ScyllaWait::set_interrupt_hook(InterruptHook hook)
+{
+  interrupt_hook = hook;
+}
+
+/**
+ * Check whether the calling thread should stop waiting
+ */
+bool ScyllaWait::interrupted()
+{
+  InterruptHook hook = interrupt_hook;
+  return hook && hook();
+}
+
+/**
+ * Start waiting
+ */
+ScyllaWait::Scope::Scope()
+{
+  if (depth++ == 0) {
+    Hook hook = begin_hook;
+    if (hook) {
+      hook();
+    }
+  }
+}
+
+/**
+ * Stop waiting
+ */
+ScyllaWait::Scope::~Scope()
+{
+  if (--depth == 0) {
+    Hook hook = end_hook;
+    if (hook) {
+      hook();
+    }
+  }
+}
+
+/**
+ * Block until a driver future completes
+ */
+bool ScyllaWait::wait(CassFuture *future, bool interruptible)
+{
+  if (cass_future_ready(future) == cass_true) {
+    return true;
+  }
+
+  Scope scope;
+  if (!interruptible) {
+    cass_future_wait(future);
+    return true;
+  }
+
+  while (cass_future_wait_timed(future, POLL_INTERVAL_US) != cass_true) {
+    if (interrupted()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Sleep interruptibly
+ */
+bool ScyllaWait::sleep(unsigned long long us)
+{
+  if (us == 0) {
+    return true;
+  }
+
+  Scope scope;
+  std::chrono::steady_clock::time_point deadline =
+    std::chrono::steady_clock::now() + std::chrono::microseconds(us);
+  for (;;) {
+    if (interrupted()) {
+      return false;
+    }
+
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (now >= deadline) {
+      return true;
+    }
+    std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(
+      deadline - now, std::chrono::microseconds(POLL_INTERVAL_US)));
+  }
+}
+
+/*
+ * ScyllaFuture implementation
+ */
+
+/**
+ * Move assignment
+ */
+ScyllaFuture& ScyllaFuture::operator=(ScyllaFuture &&other)
+{
+  if (this != &other) {
+    reset();
+    future = other.future;
+    other.future = NULL;
+  }
+  return *this;
+}
+
+/**
+ * Free the wrapped future
+ */
+void ScyllaFuture::reset()
+{
+  if (future) {
+    cass_future_free(future);
+    future = NULL;
+  }
+}
+
+/**
+ * Check for completion without blocking
+ */
+bool ScyllaFuture::ready() const
+{
+  return !future || cass_future_ready(future) == cass_true;
+}
+
+/**
+ * Block until the request completes
+ */
+bool ScyllaFuture::wait() const
+{
+  return !future || ScyllaWait::wait(future);
+}
+
+/**
+ * Error code of the request
+ */
+CassError ScyllaFuture::error_code() const
+{
+  if (!future) {
+    return CASS_ERROR_LIB_NO_HOSTS_AVAILABLE;
+  }
+  if (!wait()) {
+    return CASS_ERROR_LIB_REQUEST_TIMED_OUT;
+  }
+  return cass_future_error_code(future);
+}
+
+/**
+ * Error message of the request
+ */
+std::string ScyllaFuture::error_message() const
+{
+  if (!future) {
+    return "not connected";
+  }
+  if (!wait()) {
+    return "interrupted";
+  }
+
+  const char* message;
+  size_t message_length;
+  cass_future_error_message(future, &message, &message_length);
+  return std::string(message, message_length);
+}
+
+/**
+ * Decode all rows of the result page
+ */
+bool ScyllaFuture::get_rows(std::vector<std::string> &column_names,
+                            std::vector<std::vector<std::string>> &rows) const
+{
+  column_names.clear();
+  rows.clear();
+
+  if (error_code() != CASS_OK) {
+    return false;
+  }
+
+  const CassResult* cass_result = cass_future_get_result(future);
+  if (!cass_result) {
+    return true;
+  }
+
+  ScyllaConnection::decode_result(cass_result, column_names,
+                                  [&rows](std::vector<std::string> &row) {
+                                    rows.push_back(std::move(row));
+                                    return true;
+                                  });
+  cass_result_free(cass_result);
+
+  return true;
+}
+
+/**
+ * Driver callback; runs the registered callback once and frees it
+ */
+void ScyllaFuture::callback_trampoline(CassFuture *future, void *data)
+{
+  std::unique_ptr<Callback> callback(static_cast<Callback*>(data));
+  (*callback)(future);
+}
+
+/**
+ * Run a callback once the request completes
+ */
+bool ScyllaFuture::on_ready(const Callback &callback) const
+{
+  if (!future) {
+    return false;
+  }
+
+  Callback *data = new Callback(callback);
+  if (cass_future_set_callback(future, callback_trampoline, data) != CASS_OK) {
+    delete data;
+    return false;
+  }
+
+  return true;
+}
+
+/*
+ * ScyllaRetryPolicy implementation
+ */
+std::atomic<uint64_t> ScyllaRetryPolicy::retries(0);
+
+/**
+ * Whether a failure may go away by itself
+ */
+bool ScyllaRetryPolicy::retryable(CassError rc)
+{
+  switch (rc) {
+  case CASS_ERROR_LIB_REQUEST_TIMED_OUT:
+  case CASS_ERROR_LIB_NO_HOSTS_AVAILABLE:
+  case CASS_ERROR_SERVER_UNAVAILABLE:
+  case CASS_ERROR_SERVER_OVERLOADED:
+  case CASS_ERROR_SERVER_IS_BOOTSTRAPPING:
+  case CASS_ERROR_SERVER_WRITE_TIMEOUT:
+  case CASS_ERROR_SERVER_READ_TIMEOUT:
+    return true;
+  default:
+    return false;
+  }
+}
+
+/**
+ * Delay before retry number attempt + 1
+ */
+unsigned long long ScyllaRetryPolicy::backoff_us(unsigned int attempt) const
+{
+  unsigned long long cap_us = (unsigned long long) backoff_ms * 1000;
+  for (unsigned int i = 0; i < attempt && cap_us < (unsigned long long) max_backoff_ms * 1000; i++) {
+    cap_us *= 2;
+  }
+  if (cap_us > (unsigned long long) max_backoff_ms * 1000) {
+    cap_us = (unsigned long long) max_backoff_ms * 1000;
+  }
+  if (cap_us < 2) {
+    return cap_us;
+  }
+
+  // Half fixed, half random
+  static thread_local std::minstd_rand random(
+    (unsigned int) std::hash<std::thread::id>()(std::this_thread::get_id()));
+  return cap_us / 2 + random() % (cap_us / 2);
+}
+
+/**
+ * Fall-through policy shared by all requests the engine retries
+ */
+CassRetryPolicy *ScyllaRetryPolicy::driver_policy()
+{
+  static std::unique_ptr<CassRetryPolicy, void (*)(CassRetryPolicy*)>
+    policy(cass_retry_policy_fallthrough_new(), cass_retry_policy_free);
+  return policy.get();
+}
+
+/*
+ * ScyllaExecutor implementation
+ */
+
+/**
+ * Constructor
+ */
+ScyllaExecutor::ScyllaExecutor(const std::shared_ptr<ScyllaConnection> &conn,
+                               size_t max_in_flight,
+                               ScyllaConcurrencyLimit *shared_limit,
+                               unsigned int shared_max,
+                               const ScyllaRetryPolicy &retry)
+  : conn(conn),
+    max_in_flight(max_in_flight > 0 ? max_in_flight : 1),
+    shared_limit(shared_limit),
+    shared_max(shared_max),
+    retry(retry),
+    pending(0),
+    failed(0)
+{
+}
+
+/**
+ * Destructor; outstanding requests still reference the executor
+ */
+ScyllaExecutor::~ScyllaExecutor()
+{
+  // Retries not yet resent are dropped, including those queued by
+  // requests completing meanwhile
+  std::vector<Request*> dropped;
+  {
+    std::unique_lock<std::mutex> lock(mtx);
+    ScyllaWait::Scope waiting;
+    for (;;) {
+      dropped.insert(dropped.end(), retry_queue.begin(), retry_queue.end());
+      pending -= retry_queue.size();
+      retry_queue.clear();
+      if (pending == 0) {
+        break;
+      }
+      completed.wait(lock);
+    }
+  }
+
+  for (Request *request : dropped) {
+    if (request->done) {
+      request->done(false);
+    }
+    release(request);
+  }
+}
+
+/**
+ * Free a request and its statement or batch
+ */
+void ScyllaExecutor::release(Request *request)
+{
+  if (request->batch) {
+    cass_batch_free(request->batch);
+  } else {
+    cass_statement_free(request->statement);
+  }
+  delete request;
+}
+
+/**
+ * Give up on a request that could not be sent
+ */
+void ScyllaExecutor::abandon(Request *request, const std::string &message)
+{
+  // An earlier attempt may have been applied
+  if (request->attempt > 0 && request->done) {
+    request->done(false);
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (failed++ == 0) {
+      error = message;
+    }
+    pending--;
+    completed.notify_all();
+  }
+  release(request);
+}
+
+/**
+ * Send a request, or resend it after a retryable failure
+ */
+bool ScyllaExecutor::start(Request *request)
+{
+  if (shared_limit && !shared_limit->acquire(shared_max)) {
+    abandon(request, "interrupted");
+    return false;
+  }
+
+  std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+  ScyllaFuture future = request->batch ? conn->execute_batch_async(request->batch)
+                                       : conn->execute_async(request->statement);
+  if (future.valid() &&
+      future.on_ready([this, request, started](CassFuture *f) { finish(f, request, started); })) {
+    return true;
+  }
+
+  if (shared_limit) {
+    shared_limit->cancel();
+  }
+  abandon(request, future.valid() ? future.error_message() : "not connected");
+  return false;
+}
+
+/**
+ * Record the outcome of a request, or queue it for a retry
+ */
+void ScyllaExecutor::finish(CassFuture *future, Request *request,
+                            std::chrono::steady_clock::time_point started)
+{
+  CassError rc = cass_future_error_code(future);
+  bool ok = rc == CASS_OK;
+
+  if (shared_limit) {
+    std::chrono::microseconds latency = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - started);
+    shared_limit->release(latency.count(), rc);
+  }
+
+  // Driver threads must not sleep; the submitting thread resends the
+  // request once its backoff has passed
+  if (!ok && retry.should_retry(rc, request->attempt)) {
+    request->due = std::chrono::steady_clock::now() +
+                   std::chrono::microseconds(retry.backoff_us(request->attempt));
+    request->attempt++;
+    ScyllaRetryPolicy::retries++;
+
+    std::lock_guard<std::mutex> lock(mtx);
+    retry_queue.push_back(request);
+    completed.notify_all();
+    return;
+  }
+
+  if (request->done) {
+    request->done(ok);
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (!ok && failed++ == 0) {
+      const char* message;
+      size_t message_length;
+      cass_future_error_message(future, &message, &message_length);
+      error.assign(message, message_length);
+    }
+    pending--;
+    completed.notify_all();
+  }
+  release(request);
+}
+
+/**
+ * Whether a queued retry is due
+ */
+bool ScyllaExecutor::retry_due() const
+{
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  for (const Request *request : retry_queue) {
+    if (request->due <= now) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * Resend the retries that are due; called with the lock held
+ */
+void ScyllaExecutor::resubmit_due(std::unique_lock<std::mutex> &lock)
+{
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  std::vector<Request*> due;
+  for (size_t i = 0; i < retry_queue.size();) {
+    if (retry_queue[i]->due <= now) {
+      due.push_back(retry_queue[i]);
+      retry_queue[i] = retry_queue.back();
+      retry_queue.pop_back();
+    } else {
+      i++;
+    }
+  }
+
+  if (due.empty()) {
+    return;
+  }
+
+  lock.unlock();
+  for (Request *request : due) {
+    start(request);
+  }
+  lock.lock();
+}
+
+/**
+ * Wait for a condition, resending due retries meanwhile
+ */
+bool ScyllaExecutor::wait_for(std::unique_lock<std::mutex> &lock,
+                              const std::function<bool()> &ready)
+{
+  for (;;) {
+    resubmit_due(lock);
+    if (ready()) {
+      return true;
+    }
+    if (!ScyllaWait::wait(lock, completed, [this, &ready] { return ready() || retry_due(); })) {
+      return false;
+    }
+  }
+}
+
+/**
+ * Start executing a statement
+ */
+bool ScyllaExecutor::submit(CassStatement *statement, const Completion &done)
+{
+  Request *request = new Request();
+  request->statement = statement;
+  request->batch = NULL;
+  request->done = done;
+  request->attempt = 0;
+
+  return enqueue(request);
+}
+
+/**
+ * Start executing a batch
+ */
+bool ScyllaExecutor::submit_batch(CassBatch *batch, const Completion &done)
+{
+  Request *request = new Request();
+  request->statement = NULL;
+  request->batch = batch;
+  request->done = done;
+  request->attempt = 0;
+
+  return enqueue(request);
+}
+
+/**
+ * Wait for a free slot, then send a new request
+ */
+bool ScyllaExecutor::enqueue(Request *request)
+{
+  {
+    std::unique_lock<std::mutex> lock(mtx);
+    if (!wait_for(lock, [this] { return pending < max_in_flight; })) {
+      if (failed++ == 0) {
+        error = "interrupted";
+      }
+      lock.unlock();
+      release(request);
+      return false;
+    }
+    pending++;
+  }
+
+  return start(request);
+}
+
+/**
+ * Wait for every submitted request to complete
+ */
+bool ScyllaExecutor::wait()
+{
+  std::unique_lock<std::mutex> lock(mtx);
+  if (!wait_for(lock, [this] { return pending == 0; })) {
+    failed = 0;
+    error = "interrupted";
+    return false;
+  }
+
+  bool ok = (failed == 0);
+  failed = 0;
+  return ok;
+}
+
+/**
+ * Message of the first failure
+ */
+std::string ScyllaExecutor::first_error() const
+{
+  std::lock_guard<std::mutex> lock(mtx);
+  return error;
+}
+
+/**
+ * Requests outstanding
+ */
+size_t ScyllaExecutor::in_flight() const
+{
+  std::lock_guard<std::mutex> lock(mtx);
+  return pending;
+}
@@ -0,0 +1,388 @@
+/*
+   Copyright (c) 2025, MariaDB ScyllaDB Storage Engine
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; version 2 of the License.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+#ifndef SCYLLA_ASYNC_H
+#define SCYLLA_ASYNC_H
+
+#include <stddef.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+extern "C" {
+  #include <cassandra.h>
+}
+
+// Coroutine support needs a C++20 build (SCYLLA_CXX_STANDARD=20)
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#include <coroutine>
+#define SCYLLA_HAVE_COROUTINES 1
+#endif
+#endif
+
+class ScyllaConnection;
+class ScyllaConcurrencyLimit;
+
+/**
+ * ScyllaWait - Notification of blocking waits on ScyllaDB
+ *
+ * Every place that blocks on a request (or on another thread's request)
+ * holds a Scope. The plugin installs hooks that tell the server, so its
+ * thread pool can run other connections meanwhile. Nested scopes notify
+ * once; threads the server does not know (e.g. the CDC consumer) are
+ * ignored by the hooks.
+ *
+ * Interruptible waits wake up every POLL_INTERVAL_US to ask the interrupt
+ * hook whether the waiting statement was killed or timed out, and give up
+ * if so. The abandoned request still completes in the driver.
+ */
+class ScyllaWait
+{
+public:
+  typedef void (*Hook)();
+  typedef bool (*InterruptHook)();
+
+  static const unsigned long POLL_INTERVAL_US = 50000;
+
+  /**
+   * Install the hooks called when a thread starts and stops waiting
+   * (NULL removes them)
+   */
+  static void set_hooks(Hook begin, Hook end);
+
+  /**
+   * Install the hook telling whether the calling thread should stop
+   * waiting (NULL removes it)
+   */
+  static void set_interrupt_hook(InterruptHook hook);
+
+  /**
+   * Check whether the calling thread should stop waiting
+   */
+  static bool interrupted();
+
+  /**
+   * Marks the calling thread as waiting for its lifetime
+   */
+  class Scope
+  {
+  public:
+    Scope();
+    ~Scope();
+
+    // Prevent copying
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+  };
+
+  /**
+   * Block until a driver future completes
+   * @param future Future to wait for
+   * @param interruptible Give up if the calling thread is interrupted
+   * @return false if interrupted before the future completed
+   */
+  static bool wait(CassFuture *future, bool interruptible = true);
+
+  /**
+   * Sleep, waking up early if the calling thread is interrupted
+   * @return false if interrupted
+   */
+  static bool sleep(unsigned long long us);
+
+  /**
+   * Block on a condition variable until a predicate holds
+   * @return false if interrupted before the predicate held
+   */
+  template <class Predicate>
+  static bool wait(std::unique_lock<std::mutex> &lock, std::condition_variable &cond,
+                   Predicate done)
+  {
+    if (done()) {
+      return true;
+    }
+
+    Scope scope;
+    while (!done()) {
+      cond.wait_for(lock, std::chrono::microseconds(POLL_INTERVAL_US));
+      if (!done() && interrupted()) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+private:
+  static std::atomic<Hook> begin_hook;
+  static std::atomic<Hook> end_hook;
+  static std::atomic<InterruptHook> interrupt_hook;
+  static thread_local unsigned int depth;
+};
+
+/**
+ * ScyllaFuture - Owning wrapper of a driver future
+ *
+ * Completion can be waited for, or handled by a callback that the driver
+ * runs on one of its I/O threads (or at once in the calling thread if the
+ * future is already complete). Callbacks must be short and must not block.
+ *
+ * With C++20 the future can be co_awaited; the coroutine then resumes on
+ * the driver thread that completed the request.
+ */
+class ScyllaFuture
+{
+public:
+  typedef std::function<void(CassFuture *future)> Callback;
+
+  explicit ScyllaFuture(CassFuture *future = NULL) : future(future) {}
+  ~ScyllaFuture() { reset(); }
+
+  ScyllaFuture(ScyllaFuture &&other) : future(other.future) { other.future = NULL; }
+  ScyllaFuture& operator=(ScyllaFuture &&other);
+
+  // Prevent copying
+  ScyllaFuture(const ScyllaFuture&) = delete;
+  ScyllaFuture& operator=(const ScyllaFuture&) = delete;
+
+  bool valid() const { return future != NULL; }
+  CassFuture *get() const { return future; }
+
+  /**
+   * Check for completion without blocking
+   */
+  bool ready() const;
+
+  /**
+   * Block until the request completes
+   * @return false if the calling thread was interrupted first
+   */
+  bool wait() const;
+
+  /**
+   * Error code of the request, waiting for it to complete
+   * (CASS_ERROR_LIB_REQUEST_TIMED_OUT if the wait was interrupted)
+   */
+  CassError error_code() const;
+
+  /**
+   * Error message of the request, waiting for it to complete
+   */
+  std::string error_message() const;
+
+  /**
+   * Decode all rows of the completed request's result page
+   * @return true if the request succeeded
+   */
+  bool get_rows(std::vector<std::string> &column_names,
+                std::vector<std::vector<std::string>> &rows) const;
+
+  /**
+   * Run a callback once the request completes. The future stays owned by
+   * this wrapper, which may be destroyed before the callback runs.
+   * @return false if the callback could not be registered
+   */
+  bool on_ready(const Callback &callback) const;
+
+  /**
+   * Free the wrapped future; a registered callback still runs
+   */
+  void reset();
+
+#ifdef SCYLLA_HAVE_COROUTINES
+  struct Awaiter
+  {
+    const ScyllaFuture &f;
+
+    bool await_ready() const { return f.ready(); }
+    void await_suspend(std::coroutine_handle<> handle) const
+    {
+      if (!f.on_ready([handle](CassFuture *) { handle.resume(); })) {
+        handle.resume();
+      }
+    }
+    CassError await_resume() const { return f.error_code(); }
+  };
+
+  /**
+   * Suspend until the request completes; yields its error code
+   */
+  Awaiter operator co_await() const { return Awaiter{*this}; }
+#endif
+
+private:
+  CassFuture *future;
+
+  static void callback_trampoline(CassFuture *future, void *data);
+};
+
+/**
+ * ScyllaRetryPolicy - Retries of transient request failures
+ *
+ * Timeouts, unavailable replicas, overloaded or bootstrapping nodes and
+ * unreachable clusters are retried up to max_retries times. The backoff
+ * doubles with every attempt up to max_backoff_ms; half of it is random so
+ * sessions failing together do not retry in step. Only idempotent
+ * requests may be retried, and they carry driver_policy() so the driver
+ * does not retry them as well.
+ */
+struct ScyllaRetryPolicy
+{
+  unsigned int max_retries;     // 0 = never retry
+  unsigned int backoff_ms;      // Before the first retry
+  unsigned int max_backoff_ms;
+
+  static std::atomic<uint64_t> retries;  // Retries started by all policies
+
+  ScyllaRetryPolicy() : max_retries(0), backoff_ms(100), max_backoff_ms(2000) {}
+
+  /**
+   * Whether a failure may go away by itself
+   */
+  static bool retryable(CassError rc);
+
+  /**
+   * Whether to retry after attempt (0 = the first execution) failed
+   */
+  bool should_retry(CassError rc, unsigned int attempt) const
+  {
+    return attempt < max_retries && retryable(rc);
+  }
+
+  /**
+   * Microseconds to wait before retrying after attempt failed
+   */
+  unsigned long long backoff_us(unsigned int attempt) const;
+
+  /**
+   * Driver retry policy for idempotent requests the engine retries itself:
+   * they stay eligible for speculative execution, but the driver never
+   * retries them, so a failure is not retried twice
+   */
+  static CassRetryPolicy *driver_policy();
+};
+
+/**
+ * ScyllaExecutor - Keeps many requests in flight from one thread
+ *
+ * Requests are handed to the driver as they are submitted and complete in
+ * its I/O threads; no thread is used per request. submit() blocks only
+ * while the in-flight limit is reached. wait() collects the outcome of all
+ * requests submitted so far. Both give up if the calling thread is
+ * interrupted. The destructor waits for outstanding requests regardless,
+ * so completion callbacks never outlive the executor.
+ *
+ * With a shared concurrency limit, requests also need a slot under it, and
+ * report their latency and outcome to it on completion.
+ *
+ * Failures the retry policy accepts are queued and resent by the
+ * submitting thread, from submit() or wait(), once their backoff has
+ * passed; the request keeps its in-flight slot meanwhile.
+ */
+class ScyllaExecutor
+{
+public:
+  /**
+   * Called from a driver thread when a request completes
+   */
+  typedef std::function<void(bool ok)> Completion;
+
+  /**
+   * @param conn Connection to execute on
+   * @param max_in_flight Maximum requests outstanding at once
+   * @param shared_limit Adaptive limit shared with other executors, or NULL
+   * @param shared_max Upper bound of the shared limit
+   * @param retry Retries of failed requests, which must all be idempotent
+   */
+  ScyllaExecutor(const std::shared_ptr<ScyllaConnection> &conn, size_t max_in_flight,
+                 ScyllaConcurrencyLimit *shared_limit = NULL, unsigned int shared_max = 0,
+                 const ScyllaRetryPolicy &retry = ScyllaRetryPolicy());
+  ~ScyllaExecutor();
+
+  // Prevent copying
+  ScyllaExecutor(const ScyllaExecutor&) = delete;
+  ScyllaExecutor& operator=(const ScyllaExecutor&) = delete;
+
+  /**
+   * Start executing a statement
+   * @param statement Statement to execute, owned by the executor from now on
+   * @param done Optional completion callback, also called with false for a
+   *        retried request that is given up
+   * @return false if the request could not be started or the caller was
+   *         interrupted while waiting for a free slot
+   */
+  bool submit(CassStatement *statement, const Completion &done = Completion());
+
+  /**
+   * Start executing a batch, as submit() does for a statement
+   * @param batch Batch to execute, owned by the executor from now on
+   */
+  bool submit_batch(CassBatch *batch, const Completion &done = Completion());
+
+  /**
+   * Wait for every submitted request to complete
+   * @return true if none failed since the previous wait() and the caller
+   *         was not interrupted
+   */
+  bool wait();
+
+  /**
+   * Message of the first failure since the previous wait()
+   */
+  std::string first_error() const;
+
+  size_t in_flight() const;
+
+private:
+  std::shared_ptr<ScyllaConnection> conn;
+  size_t max_in_flight;
+  ScyllaConcurrencyLimit *shared_limit;   // Owned by conn
+  unsigned int shared_max;
+  ScyllaRetryPolicy retry;
+
+  struct Request
+  {
+    CassStatement *statement;
+    CassBatch *batch;                     // Sent instead of statement if set
+    Completion done;
+    unsigned int attempt;                 // Executions that failed so far
+    std::chrono::steady_clock::time_point due;  // Of the next retry
+  };
+
+  mutable std::mutex mtx;
+  std::condition_variable completed;
+  size_t pending;                         // Includes queued retries
+  size_t failed;
+  std::string error;
+  std::vector<Request*> retry_queue;
+
+  bool enqueue(Request *request);
+  bool start(Request *request);
+  void finish(CassFuture *future, Request *request,
+              std::chrono::steady_clock::time_point started);
+  void abandon(Request *request, const std::string &message);
+  void release(Request *request);
+  bool retry_due() const;
+  void resubmit_due(std::unique_lock<std::mutex> &lock);
+  bool wait_for(std::unique_lock<std::mutex> &lock, const std::function<bool()> &ready);
+};
+
+#endif // SCYLLA_ASYNC_H
@@ -0,0 +1,122 @@
+/*
+   Copyright (c) 2025, MariaDB ScyllaDB Storage Engine
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; version 2 of the License.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+#include "scylla_batch_builder.h"
+#include <algorithm>
+
+/**
+ * Constructor
+ */
+ScyllaBatchBuilder::ScyllaBatchBuilder()
+  : max_rows(1),
+    max_bytes(0)
+{
+}
+
+/**
+ * Destructor
+ */
+ScyllaBatchBuilder::~ScyllaBatchBuilder()
+{
+  clear();
+}
+
+/**
+ * Set the size of full batches
+ */
+void ScyllaBatchBuilder::set_limits(size_t rows, size_t bytes)
+{
+  max_rows = std::max(rows, (size_t) 1);
+  max_bytes = bytes;
+}
+
+/**
+ * Add a row to the batch of its group
+ */
+bool ScyllaBatchBuilder::add(const Row &row, int owner, Batch &full)
+{
+  std::pair<int, int64_t> key(owner, owner >= 0 ? 0 : row.token);
+  Group &group = groups[key];
+  if (group.rows.empty()) {
+    group.bytes = 0;
+  }
+
+  // Rows of one partition never share a batch; the row starts the next one
+  for (size_t i = 0; i < group.rows.size(); i++) {
+    if (group.rows[i].token == row.token) {
+      full.swap(group.rows);
+      sort(full);
+      group.rows.push_back(row);
+      group.bytes = row.bytes;
+      return true;
+    }
+  }
+
+  group.rows.push_back(row);
+  group.bytes += row.bytes;
+
+  if (group.rows.size() < max_rows && (max_bytes == 0 || group.bytes < max_bytes)) {
+    return false;
+  }
+
+  full.swap(group.rows);
+  groups.erase(key);
+  sort(full);
+  return true;
+}
+
+/**
+ * Take the rows of every group
+ */
+void ScyllaBatchBuilder::drain(std::vector<Batch> &batches)
+{
+  for (std::map<std::pair<int, int64_t>, Group>::iterator it = groups.begin();
+       it != groups.end(); ++it) {
+    batches.push_back(Batch());
+    batches.back().swap(it->second.rows);
+    sort(batches.back());
+  }
+  groups.clear();
+
+  std::sort(batches.begin(), batches.end(), [](const Batch &a, const Batch &b) {
+    return a[0].token < b[0].token;
+  });
+}
+
+/**
+ * Free the rows not taken
+ */
+void ScyllaBatchBuilder::clear()
+{
+  for (std::map<std::pair<int, int64_t>, Group>::iterator it = groups.begin();
+       it != groups.end(); ++it) {
+    for (size_t i = 0; i < it->second.rows.size(); i++) {
+      cass_statement_free(it->second.rows[i].statement);
+    }
+  }
+  groups.clear();
+}
+
+/**
+ * Sort rows by token, keeping the order of rows of one partition
+ */
+void ScyllaBatchBuilder::sort(Batch &batch)
+{
+  std::stable_sort(batch.begin(), batch.end(), [](const Row &a, const Row &b) {
+    return a.token < b.token;
+  });
+}
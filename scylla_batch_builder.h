@@ -0,0 +1,110 @@
+/*
+   Copyright (c) 2025, MariaDB ScyllaDB Storage Engine
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; version 2 of the License.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+#ifndef SCYLLA_BATCH_BUILDER_H
+#define SCYLLA_BATCH_BUILDER_H
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+extern "C" {
+  #include <cassandra.h>
+}
+
+/**
+ * ScyllaBatchBuilder - Groups the rows of a multi-row write into small
+ * unlogged batches
+ *
+ * Batches spanning many partitions make their coordinator forward every
+ * row to other replicas. Rows are grouped by the node owning their token
+ * (or by partition when owners are unknown), and a group is handed out as
+ * a batch once it reaches max_rows rows or max_bytes bytes. Rows of a batch
+ * are sorted by token and the driver routes the batch to a replica of its
+ * first row.
+ *
+ * A batch carries one timestamp for all its rows, so two rows of one
+ * partition would tie and the later one could lose. A row whose partition
+ * is already in its group hands the group out first, so the later row goes
+ * into a later batch with a later timestamp.
+ */
+class ScyllaBatchBuilder
+{
+public:
+  struct Row
+  {
+    CassStatement *statement;           // Owned by the builder until taken
+    int64_t timestamp;                  // Client timestamp, 0 if none
+    int64_t token;                      // Of the partition written
+    size_t bytes;                       // Estimated size
+    std::string tag;                    // Identifies the row to the caller
+  };
+  typedef std::vector<Row> Batch;
+
+  ScyllaBatchBuilder();
+  ~ScyllaBatchBuilder();
+
+  // Prevent copying
+  ScyllaBatchBuilder(const ScyllaBatchBuilder&) = delete;
+  ScyllaBatchBuilder& operator=(const ScyllaBatchBuilder&) = delete;
+
+  /**
+   * Set the size of full batches
+   */
+  void set_limits(size_t rows, size_t bytes);
+
+  /**
+   * Add a row to the batch of its group
+   * @param row Row to add; the builder owns its statement from now on
+   * @param owner Node owning the row's token, or -1 to group by partition
+   * @param full Receives the group's rows, sorted by token, once the group
+   *        is full or already holds a row of the same partition
+   * @return true if full was filled
+   */
+  bool add(const Row &row, int owner, Batch &full);
+
+  /**
+   * Take the rows of every group, each group as one batch sorted by token;
+   * batches come in the token order of their first row
+   */
+  void drain(std::vector<Batch> &batches);
+
+  /**
+   * Free the rows not taken
+   */
+  void clear();
+
+  bool empty() const { return groups.empty(); }
+
+private:
+  struct Group
+  {
+    Batch rows;
+    size_t bytes;
+  };
+
+  // Keyed by owner, and by token when the owner is unknown
+  std::map<std::pair<int, int64_t>, Group> groups;
+  size_t max_rows;
+  size_t max_bytes;
+
+  static void sort(Batch &batch);
+};
+
+#endif // SCYLLA_BATCH_BUILDER_H
@@ -0,0 +1,289 @@
+/*
+   Copyright (c) 2025, MariaDB ScyllaDB Storage Engine
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; version 2 of the License.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+#include "scylla_cdc.h"
+#include "scylla_connection.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+
+std::atomic<uint64_t> ScyllaCdcConsumer::changes(0);
+std::atomic<uint64_t> ScyllaCdcConsumer::poll_errors(0);
+
+/**
+ * Constructor
+ */
+ScyllaCdcConsumer::ScyllaCdcConsumer(const std::shared_ptr<ScyllaConnection> &conn,
+                                     unsigned int poll_interval_ms)
+  : conn(conn),
+    poll_interval(poll_interval_ms),
+    next_id(1),
+    stop(false)
+{
+  worker = std::thread(&ScyllaCdcConsumer::run, this);
+}
+
+/**
+ * Destructor
+ */
+ScyllaCdcConsumer::~ScyllaCdcConsumer()
+{
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    stop = true;
+  }
+  wakeup.notify_all();
+
+  if (worker.joinable()) {
+    worker.join();
+  }
+}
+
+/**
+ * Wall clock time in milliseconds, the unit of CQL timestamps
+ */
+int64_t ScyllaCdcConsumer::now_ms()
+{
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+           std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * Report changes of a table from now on
+ */
+uint64_t ScyllaCdcConsumer::subscribe(const std::string &keyspace, const std::string &table,
+                                      const std::vector<std::string> &key_columns,
+                                      const ChangeCallback &on_change)
+{
+  Subscription sub;
+  sub.keyspace = keyspace;
+  sub.table = table;
+  sub.key_columns = key_columns;
+  sub.on_change = on_change;
+  sub.polled_until_ms = now_ms();
+
+  std::lock_guard<std::mutex> lock(mtx);
+  uint64_t id = next_id++;
+  subscriptions[id] = sub;
+  return id;
+}
+
+/**
+ * Stop reporting changes of a table
+ */
+void ScyllaCdcConsumer::unsubscribe(uint64_t id)
+{
+  // Callbacks run with the lock held, so none is running once we have it
+  std::lock_guard<std::mutex> lock(mtx);
+  subscriptions.erase(id);
+}
+
+/**
+ * Read the start times of all CDC generations
+ */
+bool ScyllaCdcConsumer::load_generations()
+{
+  std::vector<std::string> names;
+  std::vector<std::vector<std::string>> rows;
+
+  if (!conn->execute("SELECT time FROM system_distributed.cdc_generation_timestamps "
+                     "WHERE key = 'timestamps'", names, rows)) {
+    return false;
+  }
+
+  generations.clear();
+  for (size_t i = 0; i < rows.size(); i++) {
+    if (rows[i].empty()) continue;
+    generations.push_back(strtoll(rows[i][0].c_str(), NULL, 10));
+  }
+
+  std::sort(generations.begin(), generations.end());
+  generations.erase(std::unique(generations.begin(), generations.end()), generations.end());
+  return true;
+}
+
+/**
+ * Get the stream ids of a generation, loading them on first use
+ * @return Stream ids, NULL if they could not be read
+ */
+const std::vector<std::string> *ScyllaCdcConsumer::load_streams(int64_t generation)
+{
+  std::map<int64_t, std::vector<std::string>>::iterator it = generation_streams.find(generation);
+  if (it != generation_streams.end()) {
+    return &it->second;
+  }
+
+  std::vector<std::string> names;
+  std::vector<std::vector<std::string>> rows;
+
+  if (!conn->execute("SELECT streams FROM system_distributed.cdc_streams_descriptions_v2 "
+                     "WHERE time = " + std::to_string(generation), names, rows)) {
+    return NULL;
+  }
+
+  // Each row holds a set of blobs, decoded as "{0x..., 0x...}"
+  std::vector<std::string> streams;
+  for (size_t i = 0; i < rows.size(); i++) {
+    if (rows[i].empty()) continue;
+    const std::string &set = rows[i][0];
+    size_t pos = set.find("0x");
+    while (pos != std::string::npos) {
+      size_t end = set.find_first_of(", }", pos);
+      streams.push_back(set.substr(pos, end == std::string::npos ? std::string::npos
+                                                                 : end - pos));
+      pos = set.find("0x", pos + 2);
+    }
+  }
+
+  // Every generation has streams; none means the description is not
+  // readable yet, so the window must not pass this generation
+  if (streams.empty()) {
+    return NULL;
+  }
+
+  std::vector<std::string> &loaded = generation_streams[generation];
+  loaded.swap(streams);
+  return &loaded;
+}
+
+/**
+ * Forget the streams of generations that ended before a time
+ */
+void ScyllaCdcConsumer::drop_streams_before(int64_t time)
+{
+  std::map<int64_t, std::vector<std::string>>::iterator it = generation_streams.begin();
+  while (it != generation_streams.end()) {
+    std::vector<int64_t>::iterator next =
+      std::upper_bound(generations.begin(), generations.end(), it->first);
+    if (next != generations.end() && *next <= time) {
+      it = generation_streams.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+/**
+ * Read the changes of one table since the last poll and report them
+ */
+bool ScyllaCdcConsumer::poll_table(uint64_t id, const Subscription &sub, int64_t now)
+{
+  std::string columns;
+  for (size_t i = 0; i < sub.key_columns.size(); i++) {
+    if (i > 0) columns += ", ";
+    columns += sub.key_columns[i];
+  }
+
+  int64_t from = sub.polled_until_ms - OVERLAP_MS;
+  std::string base = "SELECT " + columns + " FROM " + sub.keyspace + "." + sub.table +
+                     "_scylla_cdc_log WHERE \"cdc$stream_id\" IN (";
+  std::string window = ") AND \"cdc$time\" > maxTimeuuid(" + std::to_string(from) +
+                       ") AND \"cdc$time\" <= maxTimeuuid(" + std::to_string(now) + ")";
+
+  std::vector<std::vector<std::string>> keys;
+  std::vector<std::string> names;
+  std::vector<std::vector<std::string>> rows;
+
+  // Read the streams of every generation that overlaps the window; the
+  // window only advances once all of them were read
+  for (size_t g = 0; g < generations.size() && generations[g] <= now; g++) {
+    if (g + 1 < generations.size() && generations[g + 1] <= from) {
+      continue;
+    }
+
+    const std::vector<std::string> *streams = load_streams(generations[g]);
+    if (!streams) {
+      return false;
+    }
+
+    for (size_t start = 0; start < streams->size(); start += STREAMS_PER_QUERY) {
+      std::string ids;
+      for (size_t i = start; i < streams->size() && i < start + STREAMS_PER_QUERY; i++) {
+        if (i > start) ids += ", ";
+        ids += (*streams)[i];
+      }
+
+      if (!conn->execute(base + ids + window, names, rows)) {
+        return false;
+      }
+
+      for (size_t i = 0; i < rows.size(); i++) {
+        keys.push_back(std::move(rows[i]));
+      }
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(mtx);
+  std::map<uint64_t, Subscription>::iterator it = subscriptions.find(id);
+  if (it == subscriptions.end()) {
+    return true;
+  }
+
+  it->second.polled_until_ms = now;
+  if (!keys.empty()) {
+    changes += keys.size();
+    it->second.on_change(keys);
+  }
+
+  return true;
+}
+
+/**
+ * Consumer thread
+ */
+void ScyllaCdcConsumer::run()
+{
+  std::unique_lock<std::mutex> lock(mtx);
+
+  while (!stop) {
+    wakeup.wait_for(lock, std::chrono::milliseconds(poll_interval));
+    if (stop) {
+      break;
+    }
+
+    std::map<uint64_t, Subscription> pending(subscriptions);
+    if (pending.empty()) {
+      continue;
+    }
+
+    // Queries run without the lock so subscribers are never blocked on I/O
+    lock.unlock();
+
+    // Generations are re-read every time so a window never passes the
+    // start of a generation whose streams were not read
+    int64_t now = now_ms();
+    bool have_generations = load_generations();
+    if (!have_generations) {
+      poll_errors++;
+    }
+
+    int64_t oldest = now;
+    for (std::map<uint64_t, Subscription>::iterator it = pending.begin();
+         have_generations && it != pending.end(); ++it) {
+      oldest = std::min(oldest, it->second.polled_until_ms);
+      if (!poll_table(it->first, it->second, now)) {
+        poll_errors++;
+      }
+    }
+
+    if (have_generations) {
+      drop_streams_before(oldest - OVERLAP_MS);
+    }
+
+    lock.lock();
+  }
+}
@@ -0,0 +1,129 @@
+/*
+   Copyright (c) 2025, MariaDB ScyllaDB Storage Engine
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; version 2 of the License.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+#ifndef SCYLLA_CDC_H
+#define SCYLLA_CDC_H
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class ScyllaConnection;
+
+/**
+ * ScyllaCdcConsumer - Background reader of ScyllaDB CDC logs
+ *
+ * One consumer runs per cluster connection. Tables subscribe with their
+ * primary key columns; the consumer polls each table's
+ * <table>_scylla_cdc_log for changes by any client and reports the primary
+ * key values of changed rows, so cached copies can be dropped.
+ *
+ * The CDC generation timestamps are re-read from system_distributed on
+ * every poll, and the streams of each generation a poll window touches are
+ * loaded once and cached, so a window that crosses into a new generation
+ * reads both. Every poll re-reads a short overlap window so changes with
+ * slightly older write timestamps are not missed; changes may therefore
+ * be reported more than once.
+ */
+class ScyllaCdcConsumer
+{
+public:
+  /**
+   * Receives the primary key values (partition key then clustering
+   * columns, as CQL value strings) of every changed row in one poll
+   */
+  typedef std::function<void(const std::vector<std::vector<std::string>> &keys)> ChangeCallback;
+
+  // Counters over all consumers
+  static std::atomic<uint64_t> changes;       // Changed rows reported
+  static std::atomic<uint64_t> poll_errors;   // Failed log or stream queries
+
+  /**
+   * Start the consumer thread
+   * @param conn Cluster connection to read from
+   * @param poll_interval_ms Milliseconds between polls
+   */
+  ScyllaCdcConsumer(const std::shared_ptr<ScyllaConnection> &conn,
+                    unsigned int poll_interval_ms);
+  ~ScyllaCdcConsumer();
+
+  // Prevent copying
+  ScyllaCdcConsumer(const ScyllaCdcConsumer&) = delete;
+  ScyllaCdcConsumer& operator=(const ScyllaCdcConsumer&) = delete;
+
+  /**
+   * Report changes of a table from now on
+   * @param keyspace Keyspace of the base table
+   * @param table Base table name
+   * @param key_columns Partition key then clustering columns
+   * @param on_change Called from the consumer thread
+   * @return Subscription id for unsubscribe()
+   */
+  uint64_t subscribe(const std::string &keyspace, const std::string &table,
+                     const std::vector<std::string> &key_columns,
+                     const ChangeCallback &on_change);
+
+  /**
+   * Stop reporting changes; waits for a running callback to return
+   */
+  void unsubscribe(uint64_t id);
+
+private:
+  struct Subscription
+  {
+    std::string keyspace;
+    std::string table;
+    std::vector<std::string> key_columns;
+    ChangeCallback on_change;
+    int64_t polled_until_ms;            // End of the last polled window
+  };
+
+  static const size_t STREAMS_PER_QUERY = 64;
+  static const int64_t OVERLAP_MS = 2000;
+
+  std::shared_ptr<ScyllaConnection> conn;
+  unsigned int poll_interval;
+
+  std::mutex mtx;                       // Guards subscriptions and stop
+  std::condition_variable wakeup;
+  std::map<uint64_t, Subscription> subscriptions;
+  uint64_t next_id;
+  bool stop;
+
+  // Owned by the consumer thread
+  std::vector<int64_t> generations;     // Start times of CDC generations, ascending
+  // Stream ids of loaded generations as CQL blob literals, by generation start
+  std::map<int64_t, std::vector<std::string>> generation_streams;
+
+  std::thread worker;
+
+  void run();
+  bool load_generations();
+  const std::vector<std::string> *load_streams(int64_t generation);
+  void drop_streams_before(int64_t time);
+  bool poll_table(uint64_t id, const Subscription &sub, int64_t now);
+  static int64_t now_ms();
+};
+
+#endif // SCYLLA_CDC_H
@@ -0,0 +1,134 @@
+/*
+   Copyright (c) 2025, MariaDB ScyllaDB Storage Engine
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; version 2 of the License.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+#include "scylla_concurrency_limit.h"
+#include "scylla_async.h"
+
+/**
+ * Constructor
+ */
+ScyllaConcurrencyLimit::ScyllaConcurrencyLimit()
+  : overloads(0),
+    current(INITIAL_LIMIT),
+    in_flight(0),
+    baseline_us(0),
+    smoothed_us(0)
+{
+}
+
+/**
+ * Wait for a slot under the current limit
+ */
+bool ScyllaConcurrencyLimit::acquire(unsigned int max_limit)
+{
+  std::unique_lock<std::mutex> lock(mtx);
+
+  if (max_limit < 1) {
+    max_limit = 1;
+  }
+  if (current > max_limit) {
+    current = max_limit;
+  }
+
+  if (!ScyllaWait::wait(lock, slot_freed, [this] { return in_flight < (unsigned int) current; })) {
+    return false;
+  }
+
+  in_flight++;
+  return true;
+}
+
+/**
+ * Multiplicative decrease, at most once per smoothed latency
+ */
+void ScyllaConcurrencyLimit::decrease(double factor,
+                                      std::chrono::steady_clock::time_point now)
+{
+  if (now - last_decrease < std::chrono::microseconds((uint64_t) smoothed_us)) {
+    return;
+  }
+
+  last_decrease = now;
+  current *= factor;
+  if (current < 1) {
+    current = 1;
+  }
+}
+
+/**
+ * Free a slot and adjust the limit
+ */
+void ScyllaConcurrencyLimit::release(uint64_t latency_us, CassError rc)
+{
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  std::lock_guard<std::mutex> lock(mtx);
+
+  in_flight--;
+
+  if (is_overload(rc)) {
+    overloads++;
+    decrease(BACKOFF_OVERLOAD, now);
+  } else if (rc == CASS_OK) {
+    double sample = (double) latency_us;
+    if (baseline_us == 0) {
+      baseline_us = sample;
+      smoothed_us = sample;
+    }
+    baseline_us = sample < baseline_us ? sample : baseline_us + (sample - baseline_us) * 0.001;
+    smoothed_us += (sample - smoothed_us) * 0.1;
+
+    // Only a window in use is evidence that a larger one would be absorbed
+    if (sample > baseline_us * LATENCY_TOLERANCE) {
+      decrease(BACKOFF_SLOW, now);
+    } else if (in_flight + 1 >= current / 2) {
+      current += 1.0 / current;
+    }
+  }
+
+  // Other errors say nothing about load
+  slot_freed.notify_all();
+}
+
+/**
+ * Free a slot of a request that was never sent
+ */
+void ScyllaConcurrencyLimit::cancel()
+{
+  std::lock_guard<std::mutex> lock(mtx);
+  in_flight--;
+  slot_freed.notify_all();
+}
+
+/**
+ * Current limit
+ */
+unsigned int ScyllaConcurrencyLimit::limit() const
+{
+  std::lock_guard<std::mutex> lock(mtx);
+  return (unsigned int) current;
+}
+
+/**
+ * Whether an error means the cluster is overloaded
+ */
+bool ScyllaConcurrencyLimit::is_overload(CassError rc)
+{
+  return rc == CASS_ERROR_SERVER_OVERLOADED ||
+         rc == CASS_ERROR_SERVER_WRITE_TIMEOUT ||
+         rc == CASS_ERROR_SERVER_READ_TIMEOUT ||
+         rc == CASS_ERROR_LIB_REQUEST_TIMED_OUT;
+}
@@ -0,0 +1,105 @@
+/*
+   Copyright (c) 2025, MariaDB ScyllaDB Storage Engine
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; version 2 of the License.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+#ifndef SCYLLA_CONCURRENCY_LIMIT_H
+#define SCYLLA_CONCURRENCY_LIMIT_H
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+extern "C" {
+  #include <cassandra.h>
+}
+
+/**
+ * ScyllaConcurrencyLimit - Adaptive limit of requests in flight to a cluster
+ *
+ * Shared by every pipelined writer of a cluster connection, so concurrent
+ * loaders converge on one limit matching what the cluster absorbs (AIMD):
+ *
+ * - each success at normal latency, while at least half the window is in
+ *   use, raises the limit by 1/limit, i.e. by about one per round trip
+ * - a success slower than LATENCY_TOLERANCE times the baseline latency
+ *   lowers it by BACKOFF_SLOW
+ * - a timeout or overload error halves it
+ *
+ * Decreases are spaced by at least the smoothed latency, so a burst of
+ * failures from one window counts once. The baseline is the lowest
+ * latency seen, drifting slowly towards recent samples so it follows
+ * lasting changes.
+ */
+class ScyllaConcurrencyLimit
+{
+public:
+  static const unsigned int INITIAL_LIMIT = 32;
+  static constexpr double LATENCY_TOLERANCE = 2.0;
+  static constexpr double BACKOFF_SLOW = 0.9;
+  static constexpr double BACKOFF_OVERLOAD = 0.5;
+
+  std::atomic<uint64_t> overloads;      // Timeouts and overload errors seen
+
+  ScyllaConcurrencyLimit();
+
+  // Prevent copying
+  ScyllaConcurrencyLimit(const ScyllaConcurrencyLimit&) = delete;
+  ScyllaConcurrencyLimit& operator=(const ScyllaConcurrencyLimit&) = delete;
+
+  /**
+   * Wait for a slot under the current limit
+   * @param max_limit Upper bound of the limit
+   * @return false if the caller was interrupted while waiting
+   */
+  bool acquire(unsigned int max_limit);
+
+  /**
+   * Free a slot and adjust the limit from the request's outcome
+   * @param latency_us Time from submission to completion
+   * @param rc Outcome of the request
+   */
+  void release(uint64_t latency_us, CassError rc);
+
+  /**
+   * Free a slot of a request that was never sent
+   */
+  void cancel();
+
+  /**
+   * Current limit, rounded down
+   */
+  unsigned int limit() const;
+
+  /**
+   * Whether an error means the cluster is overloaded
+   */
+  static bool is_overload(CassError rc);
+
+private:
+  mutable std::mutex mtx;
+  std::condition_variable slot_freed;
+  double current;                       // Fractional so increases can be small
+  unsigned int in_flight;
+  double baseline_us;                   // 0 until the first sample
+  double smoothed_us;
+  std::chrono::steady_clock::time_point last_decrease;
+
+  void decrease(double factor, std::chrono::steady_clock::time_point now);
+};
+
+#endif // SCYLLA_CONCURRENCY_LIMIT_H
@@ -16,10 +16,12 @@
 */
 
 #include "scylla_connection.h"
+#include "scylla_cdc.h"
 #include <sstream>
 #include <iomanip>
 #include <stdexcept>
 #include <cstring>
+#include <strings.h>
 
 /*
  * ScyllaConnection implementation
@@ -29,13 +31,165 @@
  * driver that provides a C API compatible with the Cassandra driver interface.
  */
 
+/*
+ * ScyllaClusterOptions implementation
+ */
+
+/**
+ * Apply the options to a driver cluster configuration
+ */
+void ScyllaClusterOptions::apply(CassCluster* cluster) const
+{
+  if (!username.empty()) {
+    cass_cluster_set_credentials(cluster, username.c_str(), password.c_str());
+  }
+  
+  // Token awareness picks replicas among the hosts this policy allows
+  if (!local_dc.empty()) {
+    cass_cluster_set_load_balance_dc_aware(cluster, local_dc.c_str(),
+                                           used_hosts_per_remote_dc, cass_false);
+  }
+  
+  if (latency_aware) {
+    cass_cluster_set_latency_aware_routing(cluster, cass_true);
+    cass_cluster_set_latency_aware_routing_settings(cluster, latency_exclusion_threshold,
+                                                    latency_scale_ms,
+                                                    LATENCY_RETRY_PERIOD_MS,
+                                                    LATENCY_UPDATE_RATE_MS,
+                                                    LATENCY_MIN_MEASURED);
+  }
+  
+  // With token awareness the driver also picks the owning shard (and, for
+  // tablet tables, the replica of the tablet) from the statement's routing
+  // key; prepared statements derive it from their bound partition key
+  cass_cluster_set_token_aware_routing(cluster, token_aware ? cass_true : cass_false);
+  cass_cluster_set_token_aware_routing_shuffle_replicas(cluster,
+                                                        shuffle_replicas ? cass_true : cass_false);
+  
+  // Only statements marked idempotent are hedged
+  if (speculative_delay_ms > 0 && speculative_max_executions > 0) {
+    cass_cluster_set_constant_speculative_execution_policy(cluster, speculative_delay_ms,
+                                                           (int) speculative_max_executions);
+  } else {
+    cass_cluster_set_no_speculative_execution_policy(cluster);
+  }
+  
+  // Transport; zero keeps the driver's defaults
+  if (compression == COMPRESSION_LZ4) {
+    cass_cluster_set_compression(cluster, CASS_COMPRESSION_LZ4);
+  } else if (compression == COMPRESSION_SNAPPY) {
+    cass_cluster_set_compression(cluster, CASS_COMPRESSION_SNAPPY);
+  }
+  
+  if (io_threads > 0) {
+    cass_cluster_set_num_threads_io(cluster, io_threads);
+  }
+  
+  if (core_connections > 0) {
+    cass_cluster_set_core_connections_per_host(cluster, core_connections);
+  }
+  
+  if (io_queue_size > 0) {
+    cass_cluster_set_queue_size_io(cluster, io_queue_size);
+  }
+  
+  // A write resent after a timeout keeps its timestamp, so it cannot
+  // overwrite a later write of the same cell
+  CassTimestampGen *timestamp_gen = client_timestamps ? cass_timestamp_gen_monotonic_new()
+                                                      : cass_timestamp_gen_server_side_new();
+  cass_cluster_set_timestamp_gen(cluster, timestamp_gen);
+  cass_timestamp_gen_free(timestamp_gen);
+  
+  cass_cluster_set_tcp_nodelay(cluster, tcp_nodelay ? cass_true : cass_false);
+  cass_cluster_set_tcp_keepalive(cluster, tcp_keepalive_s > 0 ? cass_true : cass_false,
+                                 tcp_keepalive_s);
+  
+  // Profiles inherit every setting they leave unset from the cluster
+  for (int i = 0; i < PROFILE_COUNT; i++) {
+    const ProfileSettings &settings = profiles[i];
+    CassExecProfile *profile = cass_execution_profile_new();
+    
+    if (settings.request_timeout_ms > 0) {
+      cass_execution_profile_set_request_timeout(profile, settings.request_timeout_ms);
+    }
+    if (settings.consistency != CASS_CONSISTENCY_UNKNOWN) {
+      cass_execution_profile_set_consistency(profile, settings.consistency);
+    }
+    if (!settings.speculative) {
+      cass_execution_profile_set_no_speculative_execution_policy(profile);
+    }
+    
+    cass_cluster_set_execution_profile(cluster, profile_name((Profile) i), profile);
+    cass_execution_profile_free(profile);
+  }
+}
+
+/**
+ * Identity of the options
+ */
+std::string ScyllaClusterOptions::key() const
+{
+  std::string k;
+  k += token_aware ? 'T' : 't';
+  k += shuffle_replicas ? 'S' : 's';
+  k += "/" + std::to_string(speculative_delay_ms) + "x" + std::to_string(speculative_max_executions);
+  k += "/" + local_dc + "+" + std::to_string(used_hosts_per_remote_dc);
+  if (latency_aware) {
+    k += "/L" + std::to_string(latency_exclusion_threshold) + "," + std::to_string(latency_scale_ms);
+  }
+  k += "/C" + std::to_string((int) compression);
+  k += "/" + std::to_string(io_threads) + "," + std::to_string(core_connections) +
+       "," + std::to_string(io_queue_size);
+  k += client_timestamps ? "/W" : "/w";
+  k += tcp_nodelay ? "/N" : "/n";
+  k += std::to_string(tcp_keepalive_s);
+  for (int i = 0; i < PROFILE_COUNT; i++) {
+    k += "/" + std::to_string(profiles[i].request_timeout_ms) + "," +
+         std::to_string((int) profiles[i].consistency) + (profiles[i].speculative ? "s" : "");
+  }
+  // Sessions of different roles must not be shared; the password is only
+  // hashed into the key
+  k += "/" + username + "@" + std::to_string(std::hash<std::string>()(password));
+  return k;
+}
+
+/**
+ * Name of a profile
+ */
+const char *ScyllaClusterOptions::profile_name(Profile profile)
+{
+  switch (profile) {
+  case PROFILE_SCAN:
+    return "scan";
+  case PROFILE_BULK:
+    return "bulk";
+  default:
+    return "oltp";
+  }
+}
+
+/**
+ * Parse a profile name
+ */
+ScyllaClusterOptions::Profile ScyllaClusterOptions::profile_from_name(const std::string &name)
+{
+  for (int i = 0; i < PROFILE_COUNT; i++) {
+    if (strcasecmp(name.c_str(), profile_name((Profile) i)) == 0) {
+      return (Profile) i;
+    }
+  }
+  return PROFILE_COUNT;
+}
+
 /**
  * Constructor
  */
 ScyllaConnection::ScyllaConnection()
   : cluster(nullptr),
     session(nullptr),
-    connected(false)
+    connected(false),
+    ring_loaded(false),
+    write_coalescer(this)
 {
 }
 
@@ -56,7 +210,7 @@ void ScyllaConnection::cleanup()
   
   if (session) {
     CassFuture* close_future = cass_session_close(session);
-    cass_future_wait(close_future);
+    ScyllaWait::wait(close_future, false);
     cass_future_free(close_future);
     cass_session_free(session);
     session = nullptr;
@@ -84,7 +238,8 @@ std::string ScyllaConnection::get_error_message(CassFuture* future)
 /**
  * Connect to ScyllaDB cluster
  */
-bool ScyllaConnection::connect(const std::string &hosts, int port)
+bool ScyllaConnection::connect(const std::string &hosts, int port,
+                               const ScyllaClusterOptions &options)
 {
   std::lock_guard<std::mutex> lock(mtx);
   
@@ -109,6 +264,9 @@ bool ScyllaConnection::connect(const std::string &hosts, int port)
   cass_cluster_set_connect_timeout(cluster, 10000); // 10 seconds
   cass_cluster_set_request_timeout(cluster, 10000); // 10 seconds
   
+  // Request routing
+  options.apply(cluster);
+  
   // Create session
   session = cass_session_new();
   if (!session) {
@@ -119,7 +277,7 @@ bool ScyllaConnection::connect(const std::string &hosts, int port)
   
   // Connect session
   CassFuture* connect_future = cass_session_connect(session, cluster);
-  cass_future_wait(connect_future);
+  ScyllaWait::wait(connect_future, false);
   
   CassError rc = cass_future_error_code(connect_future);
   if (rc != CASS_OK) {
@@ -170,7 +328,7 @@ bool ScyllaConnection::use_keyspace(const std::string &keyspace)
   CassStatement* statement = cass_statement_new(cql.c_str(), 0);
   CassFuture* query_future = cass_session_execute(session, statement);
   
-  cass_future_wait(query_future);
+  ScyllaWait::wait(query_future, false);
   
   CassError rc = cass_future_error_code(query_future);
   bool success = (rc == CASS_OK);
@@ -186,578 +344,553 @@ bool ScyllaConnection::use_keyspace(const std::string &keyspace)
 }
 
 /**
- * Execute a CQL query with results
+ * Convert a single CQL value to its string representation
  */
-bool ScyllaConnection::execute(const std::string &cql, 
-                                std::vector<std::vector<std::string>> &result)
+std::string ScyllaConnection::value_to_string(const CassValue* value)
 {
-  std::lock_guard<std::mutex> lock(mtx);
-  
-  if (!connected || !session) {
-    return false;
+  if (cass_value_is_null(value)) {
+    return "NULL";
   }
   
-  result.clear();
-  
-  CassStatement* statement = cass_statement_new(cql.c_str(), 0);
-  CassFuture* query_future = cass_session_execute(session, statement);
-  
-  cass_future_wait(query_future);
+  CassValueType type = cass_value_type(value);
   
-  CassError rc = cass_future_error_code(query_future);
-  if (rc != CASS_OK) {
-    cass_future_free(query_future);
-    cass_statement_free(statement);
-    return false;
-  }
-  
-  const CassResult* cass_result = cass_future_get_result(query_future);
-  if (cass_result) {
-    CassIterator* row_iterator = cass_iterator_from_result(cass_result);
-    
-    while (cass_iterator_next(row_iterator)) {
-      const CassRow* row = cass_iterator_get_row(row_iterator);
-      std::vector<std::string> row_data;
+  switch (type) {
+    case CASS_VALUE_TYPE_TINY_INT: {
+      cass_int8_t tinyint_val;
+      cass_value_get_int8(value, &tinyint_val);
+      return std::to_string(tinyint_val);
+    }
+    case CASS_VALUE_TYPE_SMALL_INT: {
+      cass_int16_t smallint_val;
+      cass_value_get_int16(value, &smallint_val);
+      return std::to_string(smallint_val);
+    }
+    case CASS_VALUE_TYPE_INT: {
+      cass_int32_t int_val;
+      cass_value_get_int32(value, &int_val);
+      return std::to_string(int_val);
+    }
+    case CASS_VALUE_TYPE_BIGINT: {
+      cass_int64_t bigint_val;
+      cass_value_get_int64(value, &bigint_val);
+      return std::to_string(bigint_val);
+    }
+    case CASS_VALUE_TYPE_FLOAT: {
+      cass_float_t float_val;
+      cass_value_get_float(value, &float_val);
+      return std::to_string(float_val);
+    }
+    case CASS_VALUE_TYPE_DOUBLE: {
+      cass_double_t double_val;
+      cass_value_get_double(value, &double_val);
+      return std::to_string(double_val);
+    }
+    case CASS_VALUE_TYPE_BOOLEAN: {
+      cass_bool_t bool_val;
+      cass_value_get_bool(value, &bool_val);
+      return bool_val ? "1" : "0";
+    }
+    case CASS_VALUE_TYPE_TEXT:
+    case CASS_VALUE_TYPE_VARCHAR:
+    case CASS_VALUE_TYPE_ASCII: {
+      const char* str_val;
+      size_t str_len;
+      cass_value_get_string(value, &str_val, &str_len);
+      return std::string(str_val, str_len);
+    }
+    case CASS_VALUE_TYPE_TIMESTAMP: {
+      cass_int64_t timestamp_val;
+      cass_value_get_int64(value, &timestamp_val);
+      return std::to_string(timestamp_val);
+    }
+    case CASS_VALUE_TYPE_DATE: {
+      cass_uint32_t date_val;
+      cass_value_get_uint32(value, &date_val);
+      // CQL date uses 2^31 as epoch (1970-01-01), days offset from that
+      const int32_t EPOCH_OFFSET = 2147483648;
+      int32_t days_since_epoch = static_cast<int32_t>(date_val) - EPOCH_OFFSET;
       
-      size_t column_count = cass_result_column_count(cass_result);
-      for (size_t i = 0; i < column_count; i++) {
-        const CassValue* value = cass_row_get_column(row, i);
-        
-        if (cass_value_is_null(value)) {
-          row_data.push_back("NULL");
-        } else {
-          CassValueType type = cass_value_type(value);
-          
-          switch (type) {
-            case CASS_VALUE_TYPE_TINY_INT: {
-              cass_int8_t tinyint_val;
-              cass_value_get_int8(value, &tinyint_val);
-              row_data.push_back(std::to_string(tinyint_val));
-              break;
-            }
-            case CASS_VALUE_TYPE_SMALL_INT: {
-              cass_int16_t smallint_val;
-              cass_value_get_int16(value, &smallint_val);
-              row_data.push_back(std::to_string(smallint_val));
-              break;
-            }
-            case CASS_VALUE_TYPE_INT: {
-              cass_int32_t int_val;
-              cass_value_get_int32(value, &int_val);
-              row_data.push_back(std::to_string(int_val));
-              break;
-            }
-            case CASS_VALUE_TYPE_BIGINT: {
-              cass_int64_t bigint_val;
-              cass_value_get_int64(value, &bigint_val);
-              row_data.push_back(std::to_string(bigint_val));
-              break;
-            }
-            case CASS_VALUE_TYPE_FLOAT: {
-              cass_float_t float_val;
-              cass_value_get_float(value, &float_val);
-              row_data.push_back(std::to_string(float_val));
-              break;
-            }
-            case CASS_VALUE_TYPE_DOUBLE: {
-              cass_double_t double_val;
-              cass_value_get_double(value, &double_val);
-              row_data.push_back(std::to_string(double_val));
-              break;
-            }
-            case CASS_VALUE_TYPE_BOOLEAN: {
-              cass_bool_t bool_val;
-              cass_value_get_bool(value, &bool_val);
-              row_data.push_back(bool_val ? "1" : "0");
-              break;
-            }
-            case CASS_VALUE_TYPE_TEXT:
-            case CASS_VALUE_TYPE_VARCHAR:
-            case CASS_VALUE_TYPE_ASCII: {
-              const char* str_val;
-              size_t str_len;
-              cass_value_get_string(value, &str_val, &str_len);
-              row_data.push_back(std::string(str_val, str_len));
-              break;
-            }
-            case CASS_VALUE_TYPE_TIMESTAMP: {
-              cass_int64_t timestamp_val;
-              cass_value_get_int64(value, &timestamp_val);
-              row_data.push_back(std::to_string(timestamp_val));
-              break;
-            }
-            case CASS_VALUE_TYPE_DATE: {
-              cass_uint32_t date_val;
-              cass_value_get_uint32(value, &date_val);
-              // CQL date uses 2^31 as epoch (1970-01-01), days offset from that
-              const int32_t EPOCH_OFFSET = 2147483648;
-              int32_t days_since_epoch = static_cast<int32_t>(date_val) - EPOCH_OFFSET;
-              
-              // Convert to YYYY-MM-DD format
-              time_t epoch_time = static_cast<time_t>(days_since_epoch) * 86400; // seconds
-              struct tm* tm_info = gmtime(&epoch_time);
-              char date_str[11];
-              strftime(date_str, sizeof(date_str), "%Y-%m-%d", tm_info);
-              row_data.push_back(std::string(date_str));
-              break;
-            }
-            case CASS_VALUE_TYPE_UUID:
-            case CASS_VALUE_TYPE_TIMEUUID: {
-              char uuid_str[CASS_UUID_STRING_LENGTH];
-              CassUuid uuid;
-              cass_value_get_uuid(value, &uuid);
-              cass_uuid_string(uuid, uuid_str);
-              row_data.push_back(std::string(uuid_str));
-              break;
-            }
-            case CASS_VALUE_TYPE_BLOB: {
-              const cass_byte_t* bytes;
-              size_t bytes_size;
-              cass_value_get_bytes(value, &bytes, &bytes_size);
-              
-              // Convert to hex string
-              std::ostringstream hex_stream;
-              hex_stream << "0x";
-              for (size_t j = 0; j < bytes_size; j++) {
-                hex_stream << std::hex << std::setw(2) << std::setfill('0') 
-                          << static_cast<int>(bytes[j]);
-              }
-              row_data.push_back(hex_stream.str());
-              break;
-            }
-            case CASS_VALUE_TYPE_DECIMAL: {
-              const cass_byte_t* varint;
-              size_t varint_size;
-              cass_int32_t scale;
-              cass_value_get_decimal(value, &varint, &varint_size, &scale);
-              
-              // Convert varint bytes to a number
-              int64_t value_int = 0;
-              for (size_t i = 0; i < varint_size; i++) {
-                value_int = (value_int << 8) | varint[i];
-              }
-              
-              // Apply scale to create decimal string
-              std::ostringstream decimal_stream;
-              if (scale == 0) {
-                decimal_stream << value_int;
-              } else {
-                // Insert decimal point at the right position
-                std::string num_str = std::to_string(value_int);
-                if (static_cast<size_t>(scale) >= num_str.length()) {
-                  // Pad with zeros if needed
-                  decimal_stream << "0.";
-                  for (size_t i = 0; i < static_cast<size_t>(scale) - num_str.length(); i++) {
-                    decimal_stream << "0";
-                  }
-                  decimal_stream << num_str;
-                } else {
-                  size_t decimal_pos = num_str.length() - static_cast<size_t>(scale);
-                  decimal_stream << num_str.substr(0, decimal_pos) << "." 
-                                << num_str.substr(decimal_pos);
-                }
-              }
-              row_data.push_back(decimal_stream.str());
-              break;
-            }
-            case CASS_VALUE_TYPE_VARINT: {
-              const cass_byte_t* varint;
-              size_t varint_size;
-              cass_value_get_bytes(value, &varint, &varint_size);
-              
-              // Convert varint bytes to integer (big-endian, signed)
-              bool is_negative = (varint[0] & 0x80) != 0;
-              int64_t value_int = 0;
-              
-              if (is_negative) {
-                // Two's complement for negative numbers
-                value_int = -1;
-                for (size_t i = 0; i < varint_size && i < 8; i++) {
-                  value_int = (value_int << 8) | varint[i];
-                }
-              } else {
-                // Positive number
-                for (size_t i = 0; i < varint_size && i < 8; i++) {
-                  value_int = (value_int << 8) | varint[i];
-                }
-              }
-              
-              row_data.push_back(std::to_string(value_int));
-              break;
-            }
-            case CASS_VALUE_TYPE_TIME: {
-              cass_int64_t time_val;
-              cass_value_get_int64(value, &time_val);
-              // CQL time is nanoseconds since midnight
-              int64_t total_seconds = time_val / 1000000000LL;
-              int hours = total_seconds / 3600;
-              int minutes = (total_seconds % 3600) / 60;
-              int seconds = total_seconds % 60;
-              int micros = (time_val % 1000000000LL) / 1000;
-              
-              char time_str[20];
-              snprintf(time_str, sizeof(time_str), "%02d:%02d:%02d.%06d", 
-                      hours, minutes, seconds, micros);
-              row_data.push_back(std::string(time_str));
-              break;
-            }
-            case CASS_VALUE_TYPE_DURATION: {
-              cass_int32_t months, days;
-              cass_int64_t nanos;
-              cass_value_get_duration(value, &months, &days, &nanos);
-              
-              // Format as ISO 8601 duration string
-              std::ostringstream duration_stream;
-              duration_stream << "P";
-              if (months != 0) {
-                duration_stream << months << "M";
-              }
-              if (days != 0) {
-                duration_stream << days << "D";
-              }
-              if (nanos != 0) {
-                int64_t total_seconds = nanos / 1000000000LL;
-                int hours = total_seconds / 3600;
-                int minutes = (total_seconds % 3600) / 60;
-                int seconds = total_seconds % 60;
-                duration_stream << "T";
-                if (hours != 0) duration_stream << hours << "H";
-                if (minutes != 0) duration_stream << minutes << "M";
-                if (seconds != 0 || nanos % 1000000000LL != 0) {
-                  duration_stream << seconds;
-                  if (nanos % 1000000000LL != 0) {
-                    duration_stream << "." << (nanos % 1000000000LL);
-                  }
-                  duration_stream << "S";
-                }
-              }
-              if (months == 0 && days == 0 && nanos == 0) {
-                duration_stream << "T0S";
-              }
-              row_data.push_back(duration_stream.str());
-              break;
-            }
-            case CASS_VALUE_TYPE_INET: {
-              CassInet inet;
-              cass_value_get_inet(value, &inet);
-              char inet_str[CASS_INET_STRING_LENGTH];
-              cass_inet_string(inet, inet_str);
-              row_data.push_back(std::string(inet_str));
-              break;
-            }
-            default:
-              row_data.push_back("[UNSUPPORTED_TYPE]");
-              break;
+      // Convert to YYYY-MM-DD format
+      time_t epoch_time = static_cast<time_t>(days_since_epoch) * 86400; // seconds
+      struct tm* tm_info = gmtime(&epoch_time);
+      char date_str[11];
+      strftime(date_str, sizeof(date_str), "%Y-%m-%d", tm_info);
+      return std::string(date_str);
+    }
+    case CASS_VALUE_TYPE_UUID:
+    case CASS_VALUE_TYPE_TIMEUUID: {
+      char uuid_str[CASS_UUID_STRING_LENGTH];
+      CassUuid uuid;
+      cass_value_get_uuid(value, &uuid);
+      cass_uuid_string(uuid, uuid_str);
+      return std::string(uuid_str);
+    }
+    case CASS_VALUE_TYPE_BLOB: {
+      const cass_byte_t* bytes;
+      size_t bytes_size;
+      cass_value_get_bytes(value, &bytes, &bytes_size);
+      
+      // Convert to hex string
+      std::ostringstream hex_stream;
+      hex_stream << "0x";
+      for (size_t j = 0; j < bytes_size; j++) {
+        hex_stream << std::hex << std::setw(2) << std::setfill('0') 
+                  << static_cast<int>(bytes[j]);
+      }
+      return hex_stream.str();
+    }
+    case CASS_VALUE_TYPE_DECIMAL: {
+      const cass_byte_t* varint;
+      size_t varint_size;
+      cass_int32_t scale;
+      cass_value_get_decimal(value, &varint, &varint_size, &scale);
+      
+      // Convert varint bytes to a number
+      int64_t value_int = 0;
+      for (size_t i = 0; i < varint_size; i++) {
+        value_int = (value_int << 8) | varint[i];
+      }
+      
+      // Apply scale to create decimal string
+      std::ostringstream decimal_stream;
+      if (scale == 0) {
+        decimal_stream << value_int;
+      } else {
+        // Insert decimal point at the right position
+        std::string num_str = std::to_string(value_int);
+        if (static_cast<size_t>(scale) >= num_str.length()) {
+          // Pad with zeros if needed
+          decimal_stream << "0.";
+          for (size_t i = 0; i < static_cast<size_t>(scale) - num_str.length(); i++) {
+            decimal_stream << "0";
           }
+          decimal_stream << num_str;
+        } else {
+          size_t decimal_pos = num_str.length() - static_cast<size_t>(scale);
+          decimal_stream << num_str.substr(0, decimal_pos) << "." 
+                        << num_str.substr(decimal_pos);
+        }
+      }
+      return decimal_stream.str();
+    }
+    case CASS_VALUE_TYPE_VARINT: {
+      const cass_byte_t* varint;
+      size_t varint_size;
+      cass_value_get_bytes(value, &varint, &varint_size);
+      
+      // Convert varint bytes to integer (big-endian, signed)
+      bool is_negative = (varint[0] & 0x80) != 0;
+      int64_t value_int = 0;
+      
+      if (is_negative) {
+        // Two's complement for negative numbers
+        value_int = -1;
+        for (size_t i = 0; i < varint_size && i < 8; i++) {
+          value_int = (value_int << 8) | varint[i];
+        }
+      } else {
+        // Positive number
+        for (size_t i = 0; i < varint_size && i < 8; i++) {
+          value_int = (value_int << 8) | varint[i];
         }
       }
       
-      result.push_back(row_data);
+      return std::to_string(value_int);
     }
-    
-    cass_iterator_free(row_iterator);
-    cass_result_free(cass_result);
+    case CASS_VALUE_TYPE_TIME: {
+      cass_int64_t time_val;
+      cass_value_get_int64(value, &time_val);
+      // CQL time is nanoseconds since midnight
+      int64_t total_seconds = time_val / 1000000000LL;
+      int hours = total_seconds / 3600;
+      int minutes = (total_seconds % 3600) / 60;
+      int seconds = total_seconds % 60;
+      int micros = (time_val % 1000000000LL) / 1000;
+      
+      char time_str[20];
+      snprintf(time_str, sizeof(time_str), "%02d:%02d:%02d.%06d", 
+              hours, minutes, seconds, micros);
+      return std::string(time_str);
+    }
+    case CASS_VALUE_TYPE_DURATION: {
+      cass_int32_t months, days;
+      cass_int64_t nanos;
+      cass_value_get_duration(value, &months, &days, &nanos);
+      
+      // Format as ISO 8601 duration string
+      std::ostringstream duration_stream;
+      duration_stream << "P";
+      if (months != 0) {
+        duration_stream << months << "M";
+      }
+      if (days != 0) {
+        duration_stream << days << "D";
+      }
+      if (nanos != 0) {
+        int64_t total_seconds = nanos / 1000000000LL;
+        int hours = total_seconds / 3600;
+        int minutes = (total_seconds % 3600) / 60;
+        int seconds = total_seconds % 60;
+        duration_stream << "T";
+        if (hours != 0) duration_stream << hours << "H";
+        if (minutes != 0) duration_stream << minutes << "M";
+        if (seconds != 0 || nanos % 1000000000LL != 0) {
+          duration_stream << seconds;
+          if (nanos % 1000000000LL != 0) {
+            duration_stream << "." << (nanos % 1000000000LL);
+          }
+          duration_stream << "S";
+        }
+      }
+      if (months == 0 && days == 0 && nanos == 0) {
+        duration_stream << "T0S";
+      }
+      return duration_stream.str();
+    }
+    case CASS_VALUE_TYPE_INET: {
+      CassInet inet;
+      cass_value_get_inet(value, &inet);
+      char inet_str[CASS_INET_STRING_LENGTH];
+      cass_inet_string(inet, inet_str);
+      return std::string(inet_str);
+    }
+    case CASS_VALUE_TYPE_LIST:
+    case CASS_VALUE_TYPE_SET: {
+      // Elements in CQL literal form, e.g. {0x01, 0x02} for a set of blobs
+      std::string collection_str = (type == CASS_VALUE_TYPE_SET) ? "{" : "[";
+      CassIterator* items = cass_iterator_from_collection(value);
+      bool first = true;
+      while (items && cass_iterator_next(items)) {
+        if (!first) {
+          collection_str += ", ";
+        }
+        collection_str += value_to_string(cass_iterator_get_value(items));
+        first = false;
+      }
+      if (items) {
+        cass_iterator_free(items);
+      }
+      collection_str += (type == CASS_VALUE_TYPE_SET) ? "}" : "]";
+      return collection_str;
+    }
+    default:
+      return "[UNSUPPORTED_TYPE]";
   }
+}
+
+/**
+ * Decode all columns of a result row into strings
+ */
+void ScyllaConnection::decode_row(const CassRow* row, size_t column_count,
+                                  std::vector<std::string> &row_data)
+{
+  row_data.clear();
+  row_data.reserve(column_count);
   
-  cass_future_free(query_future);
+  for (size_t i = 0; i < column_count; i++) {
+    row_data.push_back(value_to_string(cass_row_get_column(row, i)));
+  }
+}
+
+/**
+ * Execute a CQL query, fetching every result page
+ */
+bool ScyllaConnection::execute_paged(const std::string &cql,
+                                     std::vector<std::string> &column_names,
+                                     const RowCallback &on_row,
+                                     unsigned int page_size)
+{
+  CassStatement* statement = cass_statement_new(cql.c_str(), 0);
+  bool success = execute_paged(statement, column_names, on_row, page_size);
   cass_statement_free(statement);
   
-  return true;
+  return success;
 }
 
-/** * Execute CQL query with column names
+/**
+ * Execute a statement, fetching every result page
  */
-bool ScyllaConnection::execute(const std::string &cql,
-                               std::vector<std::string> &column_names,
-                               std::vector<std::vector<std::string>> &result)
+bool ScyllaConnection::execute_paged(CassStatement* statement,
+                                     std::vector<std::string> &column_names,
+                                     const RowCallback &on_row,
+                                     unsigned int page_size,
+                                     const PageCallback &before_page)
 {
-  std::lock_guard<std::mutex> lock(mtx);
-  
-  if (!connected || !session) {
-    return false;
+  // The session is thread-safe; the lock only guards its lifetime state so
+  // concurrent requests from different tables are not serialized
+  CassSession* active_session;
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    
+    if (!connected || !session) {
+      return false;
+    }
+    active_session = session;
   }
   
   column_names.clear();
-  result.clear();
   
-  CassStatement* statement = cass_statement_new(cql.c_str(), 0);
-  CassFuture* query_future = cass_session_execute(session, statement);
+  if (page_size > 0) {
+    cass_statement_set_paging_size(statement, page_size);
+  }
   
-  cass_future_wait(query_future);
+  bool success = true;
+  bool more_pages = true;
   
-  CassError rc = cass_future_error_code(query_future);
-  if (rc != CASS_OK) {
+  while (success && more_pages) {
+    CassFuture* query_future = cass_session_execute(active_session, statement);
+    // Stops fetching pages once the statement is killed or times out
+    if (!ScyllaWait::wait(query_future) ||
+        cass_future_error_code(query_future) != CASS_OK) {
+      cass_future_free(query_future);
+      success = false;
+      break;
+    }
+    
+    const CassResult* cass_result = cass_future_get_result(query_future);
+    if (!cass_result) {
+      cass_future_free(query_future);
+      break;
+    }
+    
+    success = decode_result(cass_result, column_names, on_row);
+    
+    // Continue from where this page stopped
+    more_pages = success && cass_result_has_more_pages(cass_result);
+    if (more_pages) {
+      cass_statement_set_paging_state(statement, cass_result);
+      if (before_page) {
+        before_page(statement);
+      }
+    }
+    
+    cass_result_free(cass_result);
     cass_future_free(query_future);
-    cass_statement_free(statement);
-    return false;
   }
   
-  const CassResult* cass_result = cass_future_get_result(query_future);
-  if (cass_result) {
-    // Get column names
-    size_t column_count = cass_result_column_count(cass_result);
+  return success;
+}
+
+/**
+ * Decode the rows of one result page
+ */
+bool ScyllaConnection::decode_result(const CassResult* result,
+                                     std::vector<std::string> &column_names,
+                                     const RowCallback &on_row)
+{
+  size_t column_count = cass_result_column_count(result);
+  if (column_names.empty()) {
     for (size_t i = 0; i < column_count; i++) {
       const char* column_name;
       size_t column_name_length;
-      cass_result_column_name(cass_result, i, &column_name, &column_name_length);
+      cass_result_column_name(result, i, &column_name, &column_name_length);
       column_names.push_back(std::string(column_name, column_name_length));
     }
+  }
+  
+  bool success = true;
+  std::vector<std::string> row_data;
+  CassIterator* row_iterator = cass_iterator_from_result(result);
+  while (success && cass_iterator_next(row_iterator)) {
+    decode_row(cass_iterator_get_row(row_iterator), column_count, row_data);
+    // The consumer may move the row out; decode_row() resets it anyway
+    if (!on_row(row_data)) {
+      success = false;
+    }
+  }
+  cass_iterator_free(row_iterator);
+  
+  return success;
+}
+
+/**
+ * Start executing a statement without waiting for it
+ */
+ScyllaFuture ScyllaConnection::execute_async(CassStatement* statement)
+{
+  CassSession* active_session;
+  {
+    std::lock_guard<std::mutex> lock(mtx);
     
-    // Get row data (same as before)
-    CassIterator* row_iterator = cass_iterator_from_result(cass_result);
+    if (!connected || !session) {
+      return ScyllaFuture();
+    }
+    active_session = session;
+  }
+  
+  return ScyllaFuture(cass_session_execute(active_session, statement));
+}
+
+/**
+ * Start executing a batch without waiting for it
+ */
+ScyllaFuture ScyllaConnection::execute_batch_async(CassBatch* batch)
+{
+  CassSession* active_session;
+  {
+    std::lock_guard<std::mutex> lock(mtx);
     
-    while (cass_iterator_next(row_iterator)) {
-      const CassRow* row = cass_iterator_get_row(row_iterator);
-      std::vector<std::string> row_data;
-      
-      for (size_t i = 0; i < column_count; i++) {
-        const CassValue* value = cass_row_get_column(row, i);
-        
-        if (cass_value_is_null(value)) {
-          row_data.push_back("NULL");
-        } else {
-          CassValueType type = cass_value_type(value);
-          
-          switch (type) {
-            case CASS_VALUE_TYPE_TINY_INT: {
-              cass_int8_t tinyint_val;
-              cass_value_get_int8(value, &tinyint_val);
-              row_data.push_back(std::to_string(tinyint_val));
-              break;
-            }
-            case CASS_VALUE_TYPE_SMALL_INT: {
-              cass_int16_t smallint_val;
-              cass_value_get_int16(value, &smallint_val);
-              row_data.push_back(std::to_string(smallint_val));
-              break;
-            }
-            case CASS_VALUE_TYPE_INT: {
-              cass_int32_t int_val;
-              cass_value_get_int32(value, &int_val);
-              row_data.push_back(std::to_string(int_val));
-              break;
-            }
-            case CASS_VALUE_TYPE_BIGINT: {
-              cass_int64_t bigint_val;
-              cass_value_get_int64(value, &bigint_val);
-              row_data.push_back(std::to_string(bigint_val));
-              break;
-            }
-            case CASS_VALUE_TYPE_FLOAT: {
-              cass_float_t float_val;
-              cass_value_get_float(value, &float_val);
-              row_data.push_back(std::to_string(float_val));
-              break;
-            }
-            case CASS_VALUE_TYPE_DOUBLE: {
-              cass_double_t double_val;
-              cass_value_get_double(value, &double_val);
-              row_data.push_back(std::to_string(double_val));
-              break;
-            }
-            case CASS_VALUE_TYPE_BOOLEAN: {
-              cass_bool_t bool_val;
-              cass_value_get_bool(value, &bool_val);
-              row_data.push_back(bool_val ? "1" : "0");
-              break;
-            }
-            case CASS_VALUE_TYPE_TEXT:
-            case CASS_VALUE_TYPE_VARCHAR:
-            case CASS_VALUE_TYPE_ASCII: {
-              const char* str_val;
-              size_t str_len;
-              cass_value_get_string(value, &str_val, &str_len);
-              row_data.push_back(std::string(str_val, str_len));
-              break;
-            }
-            case CASS_VALUE_TYPE_TIMESTAMP: {
-              cass_int64_t timestamp_val;
-              cass_value_get_int64(value, &timestamp_val);
-              row_data.push_back(std::to_string(timestamp_val));
-              break;
-            }
-            case CASS_VALUE_TYPE_DATE: {
-              cass_uint32_t date_val;
-              cass_value_get_uint32(value, &date_val);
-              const int32_t EPOCH_OFFSET = 2147483648;
-              int32_t days_since_epoch = static_cast<int32_t>(date_val) - EPOCH_OFFSET;
-              time_t epoch_time = static_cast<time_t>(days_since_epoch) * 86400;
-              struct tm* tm_info = gmtime(&epoch_time);
-              char date_str[11];
-              strftime(date_str, sizeof(date_str), "%Y-%m-%d", tm_info);
-              row_data.push_back(std::string(date_str));
-              break;
-            }
-            case CASS_VALUE_TYPE_UUID:
-            case CASS_VALUE_TYPE_TIMEUUID: {
-              char uuid_str[CASS_UUID_STRING_LENGTH];
-              CassUuid uuid;
-              cass_value_get_uuid(value, &uuid);
-              cass_uuid_string(uuid, uuid_str);
-              row_data.push_back(std::string(uuid_str));
-              break;
-            }
-            case CASS_VALUE_TYPE_BLOB: {
-              const cass_byte_t* bytes;
-              size_t bytes_size;
-              cass_value_get_bytes(value, &bytes, &bytes_size);
-              
-              // Convert to hex string
-              std::ostringstream hex_stream;
-              hex_stream << "0x";
-              for (size_t j = 0; j < bytes_size; j++) {
-                hex_stream << std::hex << std::setw(2) << std::setfill('0') 
-                          << static_cast<int>(bytes[j]);
-              }
-              row_data.push_back(hex_stream.str());
-              break;
-            }
-            case CASS_VALUE_TYPE_DECIMAL: {
-              const cass_byte_t* varint;
-              size_t varint_size;
-              cass_int32_t scale;
-              cass_value_get_decimal(value, &varint, &varint_size, &scale);
-              
-              // Convert varint bytes to a number
-              int64_t value_int = 0;
-              for (size_t i = 0; i < varint_size; i++) {
-                value_int = (value_int << 8) | varint[i];
-              }
-              
-              // Apply scale to create decimal string
-              std::ostringstream decimal_stream;
-              if (scale == 0) {
-                decimal_stream << value_int;
-              } else {
-                // Insert decimal point at the right position
-                std::string num_str = std::to_string(value_int);
-                if (static_cast<size_t>(scale) >= num_str.length()) {
-                  // Pad with zeros if needed
-                  decimal_stream << "0.";
-                  for (size_t i = 0; i < static_cast<size_t>(scale) - num_str.length(); i++) {
-                    decimal_stream << "0";
-                  }
-                  decimal_stream << num_str;
-                } else {
-                  size_t decimal_pos = num_str.length() - static_cast<size_t>(scale);
-                  decimal_stream << num_str.substr(0, decimal_pos) << "." 
-                                << num_str.substr(decimal_pos);
-                }
-              }
-              row_data.push_back(decimal_stream.str());
-              break;
-            }
-            case CASS_VALUE_TYPE_VARINT: {
-              const cass_byte_t* varint;
-              size_t varint_size;
-              cass_value_get_bytes(value, &varint, &varint_size);
-              
-              // Convert varint bytes to integer (big-endian, signed)
-              bool is_negative = (varint[0] & 0x80) != 0;
-              int64_t value_int = 0;
-              
-              if (is_negative) {
-                // Two's complement for negative numbers
-                value_int = -1;
-                for (size_t i = 0; i < varint_size && i < 8; i++) {
-                  value_int = (value_int << 8) | varint[i];
-                }
-              } else {
-                // Positive number
-                for (size_t i = 0; i < varint_size && i < 8; i++) {
-                  value_int = (value_int << 8) | varint[i];
-                }
-              }
-              
-              row_data.push_back(std::to_string(value_int));
-              break;
-            }
-            case CASS_VALUE_TYPE_TIME: {
-              cass_int64_t time_val;
-              cass_value_get_int64(value, &time_val);
-              // CQL time is nanoseconds since midnight
-              int64_t total_seconds = time_val / 1000000000LL;
-              int hours = total_seconds / 3600;
-              int minutes = (total_seconds % 3600) / 60;
-              int seconds = total_seconds % 60;
-              int micros = (time_val % 1000000000LL) / 1000;
-              
-              char time_str[20];
-              snprintf(time_str, sizeof(time_str), "%02d:%02d:%02d.%06d", 
-                      hours, minutes, seconds, micros);
-              row_data.push_back(std::string(time_str));
-              break;
-            }
-            case CASS_VALUE_TYPE_DURATION: {
-              cass_int32_t months, days;
-              cass_int64_t nanos;
-              cass_value_get_duration(value, &months, &days, &nanos);
-              
-              // Format as ISO 8601 duration string
-              std::ostringstream duration_stream;
-              duration_stream << "P";
-              if (months != 0) {
-                duration_stream << months << "M";
-              }
-              if (days != 0) {
-                duration_stream << days << "D";
-              }
-              if (nanos != 0) {
-                int64_t total_seconds = nanos / 1000000000LL;
-                int hours = total_seconds / 3600;
-                int minutes = (total_seconds % 3600) / 60;
-                int seconds = total_seconds % 60;
-                duration_stream << "T";
-                if (hours != 0) duration_stream << hours << "H";
-                if (minutes != 0) duration_stream << minutes << "M";
-                if (seconds != 0 || nanos % 1000000000LL != 0) {
-                  duration_stream << seconds;
-                  if (nanos % 1000000000LL != 0) {
-                    duration_stream << "." << (nanos % 1000000000LL);
-                  }
-                  duration_stream << "S";
-                }
-              }
-              if (months == 0 && days == 0 && nanos == 0) {
-                duration_stream << "T0S";
-              }
-              row_data.push_back(duration_stream.str());
-              break;
-            }
-            case CASS_VALUE_TYPE_INET: {
-              CassInet inet;
-              cass_value_get_inet(value, &inet);
-              char inet_str[CASS_INET_STRING_LENGTH];
-              cass_inet_string(inet, inet_str);
-              row_data.push_back(std::string(inet_str));
-              break;
-            }
-            default:
-              row_data.push_back("[UNSUPPORTED_TYPE]");
-              break;
-          }
-        }
-      }
-      
-      result.push_back(row_data);
+    if (!connected || !session) {
+      return ScyllaFuture();
+    }
+    active_session = session;
+  }
+  
+  return ScyllaFuture(cass_session_execute_batch(active_session, batch));
+}
+
+/**
+ * Node owning a token, reloading the ring when it is stale
+ */
+int ScyllaConnection::token_owner(int64_t token)
+{
+  std::lock_guard<std::mutex> lock(ring_mtx);
+  
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  if (!ring_loaded || now - ring_time > std::chrono::milliseconds(RING_REFRESH_MS)) {
+    // A failed load is not retried before the next refresh
+    ring.load(this);
+    ring_loaded = true;
+    ring_time = now;
+  }
+  
+  return ring.owner(token);
+}
+
+/**
+ * Next client timestamp for a write
+ */
+int64_t ScyllaConnection::next_timestamp()
+{
+  static std::atomic<int64_t> last(0);
+  int64_t now = std::chrono::duration_cast<std::chrono::microseconds>(
+                  std::chrono::system_clock::now().time_since_epoch()).count();
+  int64_t prev = last.load();
+  int64_t next;
+  do {
+    next = now > prev ? now : prev + 1;
+  } while (!last.compare_exchange_weak(prev, next));
+  return next;
+}
+
+/**
+ * Parse a consistency level name
+ */
+CassConsistency ScyllaConnection::consistency_from_name(const std::string &name)
+{
+  static const struct {
+    const char *name;
+    CassConsistency consistency;
+  } levels[] = {
+    {"ANY", CASS_CONSISTENCY_ANY},
+    {"ONE", CASS_CONSISTENCY_ONE},
+    {"TWO", CASS_CONSISTENCY_TWO},
+    {"THREE", CASS_CONSISTENCY_THREE},
+    {"QUORUM", CASS_CONSISTENCY_QUORUM},
+    {"ALL", CASS_CONSISTENCY_ALL},
+    {"LOCAL_QUORUM", CASS_CONSISTENCY_LOCAL_QUORUM},
+    {"EACH_QUORUM", CASS_CONSISTENCY_EACH_QUORUM},
+    {"SERIAL", CASS_CONSISTENCY_SERIAL},
+    {"LOCAL_SERIAL", CASS_CONSISTENCY_LOCAL_SERIAL},
+    {"LOCAL_ONE", CASS_CONSISTENCY_LOCAL_ONE}
+  };
+  
+  for (size_t i = 0; i < sizeof(levels) / sizeof(levels[0]); i++) {
+    if (strcasecmp(name.c_str(), levels[i].name) == 0) {
+      return levels[i].consistency;
     }
+  }
+  
+  return CASS_CONSISTENCY_UNKNOWN;
+}
+
+/**
+ * Execute a CQL query with results
+ */
+bool ScyllaConnection::execute(const std::string &cql, 
+                                std::vector<std::vector<std::string>> &result)
+{
+  std::vector<std::string> column_names;
+  return execute(cql, column_names, result);
+}
+
+/**
+ * Execute CQL query with column names
+ */
+bool ScyllaConnection::execute(const std::string &cql,
+                               std::vector<std::string> &column_names,
+                               std::vector<std::vector<std::string>> &result)
+{
+  result.clear();
+  return execute_paged(cql, column_names,
+                       [&result](std::vector<std::string> &row) {
+                         result.push_back(std::move(row));
+                         return true;
+                       });
+}
+
+/**
+ * Prepare a CQL statement
+ */
+const CassPrepared* ScyllaConnection::prepare(const std::string &cql)
+{
+  CassSession* active_session;
+  {
+    std::lock_guard<std::mutex> lock(mtx);
     
-    cass_iterator_free(row_iterator);
-    cass_result_free(cass_result);
+    if (!connected || !session) {
+      return nullptr;
+    }
+    active_session = session;
   }
   
-  cass_future_free(query_future);
-  cass_statement_free(statement);
+  CassFuture* prepare_future = cass_session_prepare(active_session, cql.c_str());
+  // Not interruptible: a failed prepare is remembered by the caller
+  ScyllaWait::wait(prepare_future, false);
   
-  return true;
+  const CassPrepared* prepared = nullptr;
+  if (cass_future_error_code(prepare_future) == CASS_OK) {
+    prepared = cass_future_get_prepared(prepare_future);
+  }
+  
+  cass_future_free(prepare_future);
+  
+  return prepared;
 }
 
 /** * Execute a CQL query without results
  */
 bool ScyllaConnection::execute(const std::string &cql)
 {
-  std::vector<std::vector<std::string>> dummy_result;
-  return execute(cql, dummy_result);
+  std::vector<std::string> column_names;
+  return execute_paged(cql, column_names,
+                       [](std::vector<std::string> &) { return true; });
+}
+
+/**
+ * Execute a bound statement without results
+ */
+bool ScyllaConnection::execute(CassStatement* statement)
+{
+  std::vector<std::string> column_names;
+  return execute_paged(statement, column_names,
+                       [](std::vector<std::string> &) { return true; });
+}
+
+/**
+ * Number of speculative executions started by the driver
+ */
+unsigned long long ScyllaConnection::speculative_executions() const
+{
+  std::lock_guard<std::mutex> lock(mtx);
+  
+  if (!connected || !session) {
+    return 0;
+  }
+  
+  CassSpeculativeExecutionMetrics metrics;
+  cass_session_get_speculative_execution_metrics(session, &metrics);
+  return metrics.count;
 }
 
 /**
@@ -793,3 +926,119 @@ void ScyllaConnection::set_num_threads(unsigned int num_threads)
     cass_cluster_set_num_threads_io(cluster, num_threads);
   }
 }
+
+/*
+ * ScyllaConnectionPool implementation
+ */
+std::mutex ScyllaConnectionPool::mtx;
+std::map<std::string, std::weak_ptr<ScyllaConnection>> ScyllaConnectionPool::connections;
+std::map<std::string, std::weak_ptr<ScyllaCdcConsumer>> ScyllaConnectionPool::cdc_consumers;
+
+/**
+ * Get the shared connection for a cluster, connecting if needed
+ */
+std::shared_ptr<ScyllaConnection> ScyllaConnectionPool::acquire(const std::string &hosts,
+                                                                int port,
+                                                                const ScyllaClusterOptions &options)
+{
+  std::string key = hosts + ":" + std::to_string(port) + "/" + options.key();
+  
+  std::lock_guard<std::mutex> lock(mtx);
+  
+  std::shared_ptr<ScyllaConnection> conn = connections[key].lock();
+  if (conn && conn->is_connected()) {
+    return conn;
+  }
+  
+  conn = std::make_shared<ScyllaConnection>();
+  if (!conn->connect(hosts, port, options)) {
+    connections.erase(key);
+    return nullptr;
+  }
+  
+  connections[key] = conn;
+  return conn;
+}
+
+/**
+ * Get the CDC consumer of a cluster, starting it if needed
+ */
+std::shared_ptr<ScyllaCdcConsumer> ScyllaConnectionPool::cdc_consumer(const std::string &hosts,
+                                                                      int port,
+                                                                      const ScyllaClusterOptions &options,
+                                                                      unsigned int poll_interval_ms)
+{
+  std::shared_ptr<ScyllaConnection> conn = acquire(hosts, port, options);
+  if (!conn) {
+    return nullptr;
+  }
+  
+  std::string key = hosts + ":" + std::to_string(port) + "/" + options.key();
+  
+  std::lock_guard<std::mutex> lock(mtx);
+  
+  std::shared_ptr<ScyllaCdcConsumer> consumer = cdc_consumers[key].lock();
+  if (!consumer) {
+    consumer = std::make_shared<ScyllaCdcConsumer>(conn, poll_interval_ms);
+    cdc_consumers[key] = consumer;
+  }
+  
+  return consumer;
+}
+
+/**
+ * Speculative executions started over all open connections
+ */
+unsigned long long ScyllaConnectionPool::speculative_executions()
+{
+  std::lock_guard<std::mutex> lock(mtx);
+  
+  unsigned long long total = 0;
+  for (std::map<std::string, std::weak_ptr<ScyllaConnection>>::iterator it = connections.begin();
+       it != connections.end(); ++it) {
+    std::shared_ptr<ScyllaConnection> conn = it->second.lock();
+    if (conn) {
+      total += conn->speculative_executions();
+    }
+  }
+  
+  return total;
+}
+
+/**
+ * Adaptive write concurrency limits over all open connections
+ */
+unsigned long long ScyllaConnectionPool::write_concurrency_limit()
+{
+  std::lock_guard<std::mutex> lock(mtx);
+  
+  unsigned long long total = 0;
+  for (std::map<std::string, std::weak_ptr<ScyllaConnection>>::iterator it = connections.begin();
+       it != connections.end(); ++it) {
+    std::shared_ptr<ScyllaConnection> conn = it->second.lock();
+    if (conn) {
+      total += conn->write_limit.limit();
+    }
+  }
+  
+  return total;
+}
+
+/**
+ * Timeouts and overload errors seen by pipelined writers
+ */
+unsigned long long ScyllaConnectionPool::write_overloads()
+{
+  std::lock_guard<std::mutex> lock(mtx);
+  
+  unsigned long long total = 0;
+  for (std::map<std::string, std::weak_ptr<ScyllaConnection>>::iterator it = connections.begin();
+       it != connections.end(); ++it) {
+    std::shared_ptr<ScyllaConnection> conn = it->second.lock();
+    if (conn) {
+      total += conn->write_limit.overloads;
+    }
+  }
+  
+  return total;
+}
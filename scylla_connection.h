@@ -22,6 +22,9 @@
 #include <vector>
 #include <memory>
 #include <mutex>
+#include <chrono>
+#include <functional>
+#include <map>
 
 // ScyllaDB cpp-rs-driver types
 // Note: cpp-rs-driver provides a cassandra.h compatible C API
@@ -29,6 +32,104 @@ extern "C" {
   #include <cassandra.h>
 }
 
+#include "scylla_async.h"
+#include "scylla_concurrency_limit.h"
+#include "scylla_partitioner.h"
+#include "scylla_write_coalescer.h"
+
+/**
+ * ScyllaClusterOptions - Driver settings of a cluster connection
+ *
+ * Tables share a connection only if their contact points, port and
+ * options are the same.
+ */
+struct ScyllaClusterOptions
+{
+  enum Compression {
+    COMPRESSION_NONE,
+    COMPRESSION_LZ4,
+    COMPRESSION_SNAPPY
+  };
+  
+  /**
+   * Driver execution profiles; each statement runs under one of them
+   */
+  enum Profile {
+    PROFILE_OLTP,           // Primary key lookups and single-row writes
+    PROFILE_SCAN,           // Full and range scans
+    PROFILE_BULK,           // Pipelined multi-row writes
+    PROFILE_COUNT
+  };
+  
+  struct ProfileSettings
+  {
+    unsigned int request_timeout_ms;    // 0 = cluster request timeout
+    CassConsistency consistency;        // CASS_CONSISTENCY_UNKNOWN = driver default
+    bool speculative;                   // Hedge idempotent requests
+  };
+  
+  bool token_aware;         // Send requests to a replica owning their partition
+  bool shuffle_replicas;    // Spread requests over the replicas of a partition
+  unsigned int speculative_delay_ms;      // Delay before hedging an idempotent request, 0 = never
+  unsigned int speculative_max_executions; // Extra executions per request
+  std::string local_dc;     // Datacenter to prefer, empty for round-robin over all
+  unsigned int used_hosts_per_remote_dc;  // Remote hosts tried when the local DC is down
+  bool latency_aware;       // Avoid hosts much slower than the fastest
+  double latency_exclusion_threshold;     // How much slower a host may be
+  unsigned int latency_scale_ms;          // Weight decay of older latencies
+  Compression compression;  // Protocol frame compression
+  unsigned int io_threads;  // Driver I/O threads, 0 = driver default
+  unsigned int core_connections;          // Connections per host, 0 = driver default
+  unsigned int io_queue_size;             // Requests queued per I/O thread, 0 = driver default
+  bool tcp_nodelay;         // Disable Nagle's algorithm
+  unsigned int tcp_keepalive_s;           // Keepalive probe delay, 0 = no keepalive
+  bool client_timestamps;   // Writes carry monotonic timestamps from this process
+  ProfileSettings profiles[PROFILE_COUNT];
+  std::string username;     // Role to authenticate as, empty = no authentication
+  std::string password;
+  
+  ScyllaClusterOptions()
+    : token_aware(true), shuffle_replicas(true),
+      speculative_delay_ms(0), speculative_max_executions(1),
+      used_hosts_per_remote_dc(0),
+      latency_aware(false), latency_exclusion_threshold(2.0), latency_scale_ms(100),
+      compression(COMPRESSION_NONE), io_threads(0), core_connections(0),
+      io_queue_size(0), tcp_nodelay(true), tcp_keepalive_s(0), client_timestamps(true)
+  {
+    for (int i = 0; i < PROFILE_COUNT; i++) {
+      profiles[i].request_timeout_ms = 0;
+      profiles[i].consistency = CASS_CONSISTENCY_UNKNOWN;
+      profiles[i].speculative = (i == PROFILE_OLTP);
+    }
+  }
+  
+  // Latency-aware routing settings left at the driver defaults
+  static const unsigned int LATENCY_RETRY_PERIOD_MS = 10000;
+  static const unsigned int LATENCY_UPDATE_RATE_MS = 100;
+  static const unsigned int LATENCY_MIN_MEASURED = 50;
+  
+  /**
+   * Apply the options to a driver cluster configuration
+   */
+  void apply(CassCluster* cluster) const;
+  
+  /**
+   * Identity of the options, part of the connection pool key
+   */
+  std::string key() const;
+  
+  /**
+   * Name of a profile as registered with the driver
+   */
+  static const char *profile_name(Profile profile);
+  
+  /**
+   * Parse a profile name
+   * @return Profile, or PROFILE_COUNT if the name is unknown
+   */
+  static Profile profile_from_name(const std::string &name);
+};
+
 /**
  * ScyllaConnection - Manages connection to ScyllaDB cluster
  * 
@@ -45,11 +146,34 @@ private:
   bool connected;
   mutable std::mutex mtx;
   
+  // Token ring, loaded on first use and refreshed every RING_REFRESH_MS
+  std::mutex ring_mtx;
+  ScyllaTokenRing ring;
+  bool ring_loaded;
+  std::chrono::steady_clock::time_point ring_time;
+  
   // Helper methods
   void cleanup();
   std::string get_error_message(CassFuture* future);
+  static std::string value_to_string(const CassValue* value);
+  static void decode_row(const CassRow* row, size_t column_count,
+                         std::vector<std::string> &row_data);
   
 public:
+  /**
+   * Callback receiving one decoded row at a time; the row may be moved from.
+   * Returning false stops fetching further rows and pages.
+   */
+  typedef std::function<bool(std::vector<std::string> &row)> RowCallback;
+  
+  /**
+   * Callback adjusting a paged statement before a further page is requested
+   */
+  typedef std::function<void(CassStatement *statement)> PageCallback;
+  
+  static const unsigned int DEFAULT_PAGE_SIZE = 5000;
+  static const unsigned int RING_REFRESH_MS = 60000;
+  
   ScyllaConnection();
   ~ScyllaConnection();
   
@@ -61,9 +185,11 @@ public:
    * Connect to ScyllaDB cluster
    * @param hosts Comma-separated list of contact points
    * @param port Native transport port (default 9042)
+   * @param options Driver settings
    * @return true if connection successful
    */
-  bool connect(const std::string &hosts, int port = 9042);
+  bool connect(const std::string &hosts, int port = 9042,
+               const ScyllaClusterOptions &options = ScyllaClusterOptions());
   
   /**
    * Disconnect from ScyllaDB cluster
@@ -100,6 +226,79 @@ public:
   bool execute(const std::string &cql, std::vector<std::string> &column_names,
                std::vector<std::vector<std::string>> &result);
   
+  /**
+   * Execute a CQL query, following paging state until all pages are read
+   * @param cql CQL query string
+   * @param column_names Output vector of column names from result
+   * @param on_row Called for every row as it is decoded
+   * @param page_size Rows requested per page (0 uses the driver default)
+   * @return true if successful and not stopped by on_row
+   */
+  bool execute_paged(const std::string &cql, std::vector<std::string> &column_names,
+                     const RowCallback &on_row,
+                     unsigned int page_size = DEFAULT_PAGE_SIZE);
+  
+  /**
+   * Execute a statement, following paging state until all pages are read
+   * @param statement Statement to execute (owned by the caller)
+   * @param column_names Output vector of column names from result
+   * @param on_row Called for every row as it is decoded
+   * @param page_size Rows requested per page (0 uses the driver default)
+   * @param before_page Called before every page after the first
+   * @return true if successful and not stopped by on_row
+   */
+  bool execute_paged(CassStatement* statement, std::vector<std::string> &column_names,
+                     const RowCallback &on_row,
+                     unsigned int page_size = DEFAULT_PAGE_SIZE,
+                     const PageCallback &before_page = PageCallback());
+  
+  /**
+   * Start executing a statement without waiting for it
+   * @param statement Statement to execute (owned by the caller, who may free
+   *        it once this returns)
+   * @return Future of the request; not valid if not connected. Only the
+   *         first result page is fetched.
+   */
+  ScyllaFuture execute_async(CassStatement* statement);
+  
+  /**
+   * Start executing a batch without waiting for it
+   * @param batch Batch to execute (owned by the caller, who may free it
+   *        once this returns)
+   * @return Future of the request; not valid if not connected
+   */
+  ScyllaFuture execute_batch_async(CassBatch* batch);
+  
+  /**
+   * Decode the rows of one result page
+   * @param result Result page
+   * @param column_names Filled with the result's column names if empty
+   * @param on_row Called for every row as it is decoded
+   * @return false if stopped by on_row
+   */
+  static bool decode_result(const CassResult* result, std::vector<std::string> &column_names,
+                            const RowCallback &on_row);
+  
+  /**
+   * Parse a consistency level name (e.g. "LOCAL_ONE"), ignoring case
+   * @return The level, or CASS_CONSISTENCY_UNKNOWN if not recognized
+   */
+  static CassConsistency consistency_from_name(const std::string &name);
+  
+  /**
+   * Next client timestamp for a write: microseconds since the epoch,
+   * increasing across the whole process. A write keeps the timestamp it
+   * was given for all of its retries
+   */
+  static int64_t next_timestamp();
+  
+  /**
+   * Prepare a CQL statement
+   * @param cql CQL statement with bind markers
+   * @return Prepared statement (free with cass_prepared_free) or NULL on error
+   */
+  const CassPrepared* prepare(const std::string &cql);
+  
   /**
    * Execute a CQL query without returning results
    * @param cql CQL query string
@@ -107,6 +306,34 @@ public:
    */
   bool execute(const std::string &cql);
   
+  /**
+   * Execute a bound statement without returning results
+   * @param statement Statement to execute (owned by the caller)
+   * @return true if successful
+   */
+  bool execute(CassStatement* statement);
+  
+  /**
+   * Number of speculative executions started by the driver
+   */
+  unsigned long long speculative_executions() const;
+  
+  /**
+   * Adaptive limit shared by the pipelined writers of this connection
+   */
+  ScyllaConcurrencyLimit write_limit;
+  
+  /**
+   * Node owning a token, for grouping writes by replica
+   * @return Node number, or -1 if the token ring is unknown
+   */
+  int token_owner(int64_t token);
+  
+  /**
+   * Batches single-row writes of the sessions sharing this connection
+   */
+  ScyllaWriteCoalescer write_coalescer;
+  
   /**
    * Get current keyspace
    */
@@ -125,4 +352,59 @@ public:
   void set_num_threads(unsigned int num_threads);
 };
 
+class ScyllaCdcConsumer;
+
+/**
+ * ScyllaConnectionPool - Process-wide registry of cluster connections
+ *
+ * All tables pointing at the same contact points and port share one
+ * connected session; the driver multiplexes concurrent requests on it.
+ * A connection is closed once the last table using it goes away.
+ */
+class ScyllaConnectionPool
+{
+private:
+  static std::mutex mtx;
+  static std::map<std::string, std::weak_ptr<ScyllaConnection>> connections;
+  static std::map<std::string, std::weak_ptr<ScyllaCdcConsumer>> cdc_consumers;
+  
+public:
+  /**
+   * Get the shared connection for a cluster, connecting if needed
+   * @param hosts Comma-separated list of contact points
+   * @param port Native transport port
+   * @param options Driver settings
+   * @return Connected session, or NULL if the cluster is unreachable
+   */
+  static std::shared_ptr<ScyllaConnection> acquire(const std::string &hosts, int port,
+                                                   const ScyllaClusterOptions &options);
+  
+  /**
+   * Get the CDC consumer of a cluster, starting it if needed
+   * @param hosts Comma-separated list of contact points
+   * @param port Native transport port
+   * @param options Driver settings
+   * @param poll_interval_ms Milliseconds between polls for a new consumer
+   * @return Consumer, or NULL if the cluster is unreachable
+   */
+  static std::shared_ptr<ScyllaCdcConsumer> cdc_consumer(const std::string &hosts, int port,
+                                                         const ScyllaClusterOptions &options,
+                                                         unsigned int poll_interval_ms);
+  
+  /**
+   * Speculative executions started over all open connections
+   */
+  static unsigned long long speculative_executions();
+  
+  /**
+   * Adaptive write concurrency limits summed over all open connections
+   */
+  static unsigned long long write_concurrency_limit();
+  
+  /**
+   * Timeouts and overload errors seen by pipelined writers
+   */
+  static unsigned long long write_overloads();
+};
+
 #endif // SCYLLA_CONNECTION_H
@@ -0,0 +1,209 @@
+/*
+   Copyright (c) 2025, MariaDB ScyllaDB Storage Engine
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; version 2 of the License.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+#include "scylla_partitioner.h"
+#include "scylla_connection.h"
+#include <stdlib.h>
+#include <string.h>
+
+static inline uint64_t rotl64(uint64_t value, int bits)
+{
+  return (value << bits) | (value >> (64 - bits));
+}
+
+static inline uint64_t fmix64(uint64_t k)
+{
+  k ^= k >> 33;
+  k *= 0xff51afd7ed558ccdULL;
+  k ^= k >> 33;
+  k *= 0xc4ceb9fe1a85ec53ULL;
+  k ^= k >> 33;
+  return k;
+}
+
+static inline uint64_t load_le64(const unsigned char *p)
+{
+  uint64_t value = 0;
+  for (int i = 7; i >= 0; i--) {
+    value = (value << 8) | p[i];
+  }
+  return value;
+}
+
+/**
+ * Tail byte sign-extended, as Java's (long) byteValue
+ */
+static inline uint64_t tail_byte(const unsigned char *tail, int i, int shift)
+{
+  return ((uint64_t) (int64_t) (int8_t) tail[i]) << shift;
+}
+
+/**
+ * Murmur3 x64 128-bit hash, first half
+ */
+int64_t ScyllaPartitioner::murmur3(const char *key, size_t length)
+{
+  const unsigned char *data = reinterpret_cast<const unsigned char*>(key);
+  const uint64_t c1 = 0x87c37b91114253d5ULL;
+  const uint64_t c2 = 0x4cf5ad432745937fULL;
+  uint64_t h1 = 0;
+  uint64_t h2 = 0;
+
+  size_t blocks = length / 16;
+  for (size_t i = 0; i < blocks; i++) {
+    uint64_t k1 = load_le64(data + i * 16);
+    uint64_t k2 = load_le64(data + i * 16 + 8);
+
+    k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+    h1 = rotl64(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+
+    k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+    h2 = rotl64(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+  }
+
+  const unsigned char *tail = data + blocks * 16;
+  uint64_t k1 = 0;
+  uint64_t k2 = 0;
+
+  switch (length & 15) {
+    case 15: k2 ^= tail_byte(tail, 14, 48); /* fall through */
+    case 14: k2 ^= tail_byte(tail, 13, 40); /* fall through */
+    case 13: k2 ^= tail_byte(tail, 12, 32); /* fall through */
+    case 12: k2 ^= tail_byte(tail, 11, 24); /* fall through */
+    case 11: k2 ^= tail_byte(tail, 10, 16); /* fall through */
+    case 10: k2 ^= tail_byte(tail, 9, 8);   /* fall through */
+    case 9:
+      k2 ^= tail_byte(tail, 8, 0);
+      k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+      /* fall through */
+    case 8: k1 ^= tail_byte(tail, 7, 56);   /* fall through */
+    case 7: k1 ^= tail_byte(tail, 6, 48);   /* fall through */
+    case 6: k1 ^= tail_byte(tail, 5, 40);   /* fall through */
+    case 5: k1 ^= tail_byte(tail, 4, 32);   /* fall through */
+    case 4: k1 ^= tail_byte(tail, 3, 24);   /* fall through */
+    case 3: k1 ^= tail_byte(tail, 2, 16);   /* fall through */
+    case 2: k1 ^= tail_byte(tail, 1, 8);    /* fall through */
+    case 1:
+      k1 ^= tail_byte(tail, 0, 0);
+      k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+      break;
+  }
+
+  h1 ^= length;
+  h2 ^= length;
+  h1 += h2;
+  h2 += h1;
+  h1 = fmix64(h1);
+  h2 = fmix64(h2);
+  h1 += h2;
+
+  return (int64_t) h1;
+}
+
+/**
+ * Token of a serialized partition key
+ */
+int64_t ScyllaPartitioner::token(const std::vector<std::string> &components)
+{
+  int64_t hash;
+  if (components.size() == 1) {
+    hash = murmur3(components[0].data(), components[0].size());
+  } else {
+    // Composite keys hash each component as <length:2><value><0>
+    std::string key;
+    for (size_t i = 0; i < components.size(); i++) {
+      key += (char) ((components[i].size() >> 8) & 0xff);
+      key += (char) (components[i].size() & 0xff);
+      key += components[i];
+      key += '\0';
+    }
+    hash = murmur3(key.data(), key.size());
+  }
+
+  // The minimum token is reserved
+  return hash == INT64_MIN ? INT64_MAX : hash;
+}
+
+/**
+ * Load the tokens of all nodes
+ */
+bool ScyllaTokenRing::load(ScyllaConnection *conn)
+{
+  tokens.clear();
+  if (!load_tokens(conn, "SELECT tokens FROM system.local", 0) ||
+      !load_tokens(conn, "SELECT tokens FROM system.peers", 1)) {
+    tokens.clear();
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Add the tokens of each row of a system table, numbering nodes from
+ * first_node
+ */
+bool ScyllaTokenRing::load_tokens(ScyllaConnection *conn, const char *cql, int first_node)
+{
+  CassStatement *statement = cass_statement_new(cql, 0);
+  ScyllaFuture future = conn->execute_async(statement);
+  cass_statement_free(statement);
+  if (!future.valid() || future.error_code() != CASS_OK) {
+    return false;
+  }
+
+  const CassResult *result = cass_future_get_result(future.get());
+  if (!result) {
+    return false;
+  }
+
+  CassIterator *rows = cass_iterator_from_result(result);
+  for (int node = first_node; cass_iterator_next(rows); node++) {
+    const CassValue *set = cass_row_get_column(cass_iterator_get_row(rows), 0);
+    CassIterator *values = cass_iterator_from_collection(set);
+    if (!values) {
+      continue;
+    }
+    while (cass_iterator_next(values)) {
+      const char *text;
+      size_t length;
+      if (cass_value_get_string(cass_iterator_get_value(values), &text, &length) == CASS_OK) {
+        tokens[strtoll(std::string(text, length).c_str(), NULL, 10)] = node;
+      }
+    }
+    cass_iterator_free(values);
+  }
+  cass_iterator_free(rows);
+  cass_result_free(result);
+
+  return true;
+}
+
+/**
+ * Node owning a token
+ */
+int ScyllaTokenRing::owner(int64_t token) const
+{
+  if (tokens.empty()) {
+    return -1;
+  }
+
+  std::map<int64_t, int>::const_iterator it = tokens.lower_bound(token);
+  if (it == tokens.end()) {
+    it = tokens.begin();
+  }
+  return it->second;
+}
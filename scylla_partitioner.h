@@ -0,0 +1,83 @@
+/*
+   Copyright (c) 2025, MariaDB ScyllaDB Storage Engine
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; version 2 of the License.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+#ifndef SCYLLA_PARTITIONER_H
+#define SCYLLA_PARTITIONER_H
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+
+class ScyllaConnection;
+
+/**
+ * ScyllaPartitioner - Client-side Murmur3Partitioner
+ *
+ * Computes the token ScyllaDB assigns to a partition key, so writes can be
+ * grouped by partition and replica before they are sent.
+ */
+class ScyllaPartitioner
+{
+public:
+  /**
+   * Token of a serialized partition key
+   * @param components Serialized value of each partition key column
+   * @return Murmur3 token, as ScyllaDB computes it
+   */
+  static int64_t token(const std::vector<std::string> &components);
+
+  /**
+   * Murmur3 x64 128-bit hash of a key, first half, with the sign
+   * extension of tail bytes that Cassandra and ScyllaDB keep for
+   * compatibility
+   */
+  static int64_t murmur3(const char *key, size_t length);
+};
+
+/**
+ * ScyllaTokenRing - Vnode tokens of the cluster's nodes
+ *
+ * Read from system.local and system.peers of the coordinator. The first
+ * node at or after a token owns it; with vnodes that node is a replica of
+ * the partition under every replication strategy. Keyspaces using tablets
+ * place partitions differently, so owners are a grouping hint only.
+ */
+class ScyllaTokenRing
+{
+public:
+  /**
+   * Load the tokens of all nodes
+   * @return false if the system tables could not be read
+   */
+  bool load(ScyllaConnection *conn);
+
+  /**
+   * Node owning a token
+   * @return Node number, or -1 if the ring is empty
+   */
+  int owner(int64_t token) const;
+
+  bool empty() const { return tokens.empty(); }
+
+private:
+  std::map<int64_t, int> tokens;        // Token to node number
+
+  bool load_tokens(ScyllaConnection *conn, const char *cql, int first_node);
+};
+
+#endif // SCYLLA_PARTITIONER_H
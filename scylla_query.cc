@@ -18,6 +18,7 @@
 #include "scylla_query.h"
 #include "scylla_types.h"
 #include <sstream>
+#include <algorithm>
 #include <my_bitmap.h>
 
 /**
@@ -343,3 +344,137 @@ std::string ScyllaQueryBuilder::build_where_from_key(TABLE *table,
   
   return oss.str();
 }
+
+/**
+ * Get the primary key field indexes, or the first field if there is none
+ */
+void ScyllaQueryBuilder::get_primary_key_fields(TABLE *table, std::vector<uint> &pk_fields)
+{
+  pk_fields.clear();
+  
+  if (table->s->primary_key != MAX_KEY) {
+    KEY *key_info = &table->key_info[table->s->primary_key];
+    for (uint i = 0; i < key_info->user_defined_key_parts; i++) {
+      pk_fields.push_back(key_info->key_part[i].fieldnr - 1);
+    }
+  } else if (table->s->fields > 0) {
+    pk_fields.push_back(0);
+  }
+}
+
+/**
+ * Append " WHERE a = ? AND b = ?" for the given fields
+ */
+void ScyllaQueryBuilder::append_key_condition(TABLE *table,
+                                              const std::vector<uint> &key_fields,
+                                              ScyllaStatementTemplate &tpl)
+{
+  tpl.key_start = tpl.fields.size();
+  
+  for (size_t i = 0; i < key_fields.size(); i++) {
+    tpl.cql += (i == 0) ? " WHERE " : " AND ";
+    tpl.cql += table->field[key_fields[i]]->field_name.str;
+    tpl.cql += " = ?";
+    tpl.fields.push_back(key_fields[i]);
+  }
+}
+
+/**
+ * Build INSERT template binding every field
+ */
+ScyllaStatementTemplate ScyllaQueryBuilder::build_insert_template(TABLE *table,
+                                                                  const std::string &keyspace,
+                                                                  const std::string &table_name)
+{
+  ScyllaStatementTemplate tpl;
+  std::string markers;
+  
+  for (uint i = 0; i < table->s->fields; i++) {
+    markers += (i == 0) ? "?" : ", ?";
+    tpl.fields.push_back(i);
+  }
+  
+  tpl.cql = "INSERT INTO " + keyspace + "." + table_name + " (" +
+            build_column_list(table) + ") VALUES (" + markers + ")";
+  tpl.key_start = tpl.fields.size();
+  
+  return tpl;
+}
+
+/**
+ * Build UPDATE template setting the written non-key fields
+ */
+ScyllaStatementTemplate ScyllaQueryBuilder::build_update_template(TABLE *table,
+                                                                  const MY_BITMAP *write_set,
+                                                                  const std::string &keyspace,
+                                                                  const std::string &table_name)
+{
+  ScyllaStatementTemplate tpl;
+  std::vector<uint> pk_fields;
+  get_primary_key_fields(table, pk_fields);
+  
+  // Primary key columns cannot be SET in CQL; like build_set_clause() they
+  // only identify the row
+  for (int pass = 0; pass < 2 && tpl.fields.empty(); pass++) {
+    for (uint i = 0; i < table->s->fields; i++) {
+      if (std::find(pk_fields.begin(), pk_fields.end(), i) != pk_fields.end()) {
+        continue;
+      }
+      // The second pass sets every column if no written column is left
+      if (pass == 0 && write_set && !bitmap_is_set(write_set, i)) {
+        continue;
+      }
+      
+      tpl.cql += tpl.fields.empty() ? "" : ", ";
+      tpl.cql += table->field[i]->field_name.str;
+      tpl.cql += " = ?";
+      tpl.fields.push_back(i);
+    }
+  }
+  
+  tpl.cql = "UPDATE " + keyspace + "." + table_name + " SET " + tpl.cql;
+  append_key_condition(table, pk_fields, tpl);
+  
+  return tpl;
+}
+
+/**
+ * Build DELETE template for a primary key
+ */
+ScyllaStatementTemplate ScyllaQueryBuilder::build_delete_template(TABLE *table,
+                                                                  const std::string &keyspace,
+                                                                  const std::string &table_name)
+{
+  ScyllaStatementTemplate tpl;
+  std::vector<uint> pk_fields;
+  get_primary_key_fields(table, pk_fields);
+  
+  tpl.cql = "DELETE FROM " + keyspace + "." + table_name;
+  append_key_condition(table, pk_fields, tpl);
+  
+  return tpl;
+}
+
+/**
+ * Build SELECT template matching a prefix of an index
+ */
+ScyllaStatementTemplate ScyllaQueryBuilder::build_key_lookup_template(TABLE *table,
+                                                                      uint index,
+                                                                      uint key_parts,
+                                                                      const std::string &keyspace,
+                                                                      const std::string &table_name)
+{
+  ScyllaStatementTemplate tpl;
+  std::vector<uint> key_fields;
+  KEY *key_info = &table->key_info[index];
+  
+  for (uint i = 0; i < key_parts && i < key_info->user_defined_key_parts; i++) {
+    key_fields.push_back(key_info->key_part[i].fieldnr - 1);
+  }
+  
+  tpl.cql = "SELECT " + build_column_list(table) + " FROM " + keyspace + "." + table_name;
+  append_key_condition(table, key_fields, tpl);
+  tpl.cql += " ALLOW FILTERING";
+  
+  return tpl;
+}
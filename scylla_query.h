@@ -23,19 +23,41 @@
 #include <string>
 #include <vector>
 
+/**
+ * ScyllaStatementTemplate - CQL statement with bind markers, built once
+ * per table and bound with row values for every execution
+ */
+struct ScyllaStatementTemplate
+{
+  std::string cql;           // CQL text with '?' bind markers
+  std::vector<uint> fields;  // Field index bound to each marker, in order
+  size_t key_start;          // First marker of the WHERE key condition
+  
+  ScyllaStatementTemplate() : key_start(0) {}
+};
+
 /**
  * ScyllaQueryBuilder - Builds CQL queries from MariaDB operations
  */
 class ScyllaQueryBuilder
 {
 private:
-  std::string build_column_list(TABLE *table);
   std::string build_values_list(TABLE *table, const uchar *buf);
   std::string build_primary_key_where(TABLE *table, const uchar *buf);
   std::string build_set_clause(TABLE *table, const uchar *old_data, const uchar *new_data);
   bool has_where_clause(const std::string &where_clause);
+  void get_primary_key_fields(TABLE *table, std::vector<uint> &pk_fields);
+  void append_key_condition(TABLE *table, const std::vector<uint> &key_fields,
+                            ScyllaStatementTemplate &tpl);
   
 public:
+  /**
+   * Build comma-separated list of all columns in field order
+   * @param table MariaDB table structure
+   * @return Column list
+   */
+  std::string build_column_list(TABLE *table);
+  
   /**
    * Build CREATE TABLE CQL statement
    * @param table MariaDB table structure
@@ -107,6 +129,51 @@ public:
    */
   std::string build_where_from_key(TABLE *table, const uchar *key,
                                     key_part_map keypart_map);
+  
+  /**
+   * Build INSERT template binding every field
+   * @param table MariaDB table structure
+   * @param keyspace ScyllaDB keyspace name
+   * @param table_name ScyllaDB table name
+   * @return Statement template
+   */
+  ScyllaStatementTemplate build_insert_template(TABLE *table, const std::string &keyspace,
+                                                const std::string &table_name);
+  
+  /**
+   * Build UPDATE template setting the written non-key fields
+   * @param table MariaDB table structure
+   * @param write_set Fields written by the statement (NULL for all)
+   * @param keyspace ScyllaDB keyspace name
+   * @param table_name ScyllaDB table name
+   * @return Statement template
+   */
+  ScyllaStatementTemplate build_update_template(TABLE *table, const MY_BITMAP *write_set,
+                                                const std::string &keyspace,
+                                                const std::string &table_name);
+  
+  /**
+   * Build DELETE template for a primary key
+   * @param table MariaDB table structure
+   * @param keyspace ScyllaDB keyspace name
+   * @param table_name ScyllaDB table name
+   * @return Statement template
+   */
+  ScyllaStatementTemplate build_delete_template(TABLE *table, const std::string &keyspace,
+                                                const std::string &table_name);
+  
+  /**
+   * Build SELECT template matching a prefix of an index
+   * @param table MariaDB table structure
+   * @param index Index number
+   * @param key_parts Number of leading key parts to match
+   * @param keyspace ScyllaDB keyspace name
+   * @param table_name ScyllaDB table name
+   * @return Statement template
+   */
+  ScyllaStatementTemplate build_key_lookup_template(TABLE *table, uint index, uint key_parts,
+                                                    const std::string &keyspace,
+                                                    const std::string &table_name);
 };
 
 #endif // SCYLLA_QUERY_H
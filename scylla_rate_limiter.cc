@@ -0,0 +1,64 @@
+/*
+   Copyright (c) 2025, MariaDB ScyllaDB Storage Engine
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; version 2 of the License.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+#include "scylla_rate_limiter.h"
+#include "scylla_async.h"
+
+/**
+ * Constructor
+ */
+ScyllaRateLimiter::ScyllaRateLimiter()
+  : tokens(0),
+    refilled(std::chrono::steady_clock::now())
+{
+}
+
+/**
+ * Take units from the bucket, waiting until the rate allows them
+ */
+bool ScyllaRateLimiter::acquire(double amount, double rate, uint64_t *waited_us)
+{
+  if (rate <= 0) {
+    return true;
+  }
+
+  double debt;
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    std::chrono::duration<double> elapsed = now - refilled;
+    refilled = now;
+
+    // A lowered rate also caps tokens saved up at the old one
+    tokens += elapsed.count() * rate;
+    if (tokens > rate) {
+      tokens = rate;
+    }
+
+    tokens -= amount;
+    debt = -tokens;
+  }
+
+  if (debt <= 0) {
+    return true;
+  }
+
+  uint64_t wait_us = (uint64_t) (debt / rate * 1000000.0);
+  *waited_us += wait_us;
+  return ScyllaWait::sleep(wait_us);
+}
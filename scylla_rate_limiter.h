@@ -0,0 +1,58 @@
+/*
+   Copyright (c) 2025, MariaDB ScyllaDB Storage Engine
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; version 2 of the License.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+#ifndef SCYLLA_RATE_LIMITER_H
+#define SCYLLA_RATE_LIMITER_H
+
+#include <stdint.h>
+#include <chrono>
+#include <mutex>
+
+/**
+ * ScyllaRateLimiter - Token bucket shared by the sessions it throttles
+ *
+ * The bucket refills at the rate given by each caller and holds at most
+ * one second of it. A caller takes its units at once, even if that drives
+ * the bucket into debt, and then sleeps until the debt it joined behind is
+ * paid off. Callers are therefore admitted in arrival order, and sessions
+ * that keep asking get equal shares of the rate.
+ */
+class ScyllaRateLimiter
+{
+public:
+  ScyllaRateLimiter();
+
+  // Prevent copying
+  ScyllaRateLimiter(const ScyllaRateLimiter&) = delete;
+  ScyllaRateLimiter& operator=(const ScyllaRateLimiter&) = delete;
+
+  /**
+   * Take units from the bucket, waiting until the rate allows them
+   * @param amount Units consumed
+   * @param rate Units per second, 0 = unlimited
+   * @param waited_us Incremented by the microseconds spent waiting
+   * @return false if the caller was interrupted while waiting
+   */
+  bool acquire(double amount, double rate, uint64_t *waited_us);
+
+private:
+  std::mutex mtx;
+  double tokens;                                  // Negative while in debt
+  std::chrono::steady_clock::time_point refilled;
+};
+
+#endif // SCYLLA_RATE_LIMITER_H
@@ -0,0 +1,287 @@
+/*
+   Copyright (c) 2025, MariaDB ScyllaDB Storage Engine
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; version 2 of the License.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+#include "scylla_result_buffer.h"
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+// Encoded rows are flushed to the spill file in chunks of this size
+static const size_t SPILL_FLUSH_SIZE = 256 * 1024;
+
+/**
+ * Constructor
+ */
+ScyllaResultBuffer::ScyllaResultBuffer()
+  : memory_budget(0),
+    memory_bytes(0),
+    spill_fd(-1),
+    spill_errno(0),
+    spill_length(0),
+    map_base(nullptr),
+    map_length(0)
+{
+}
+
+/**
+ * Destructor
+ */
+ScyllaResultBuffer::~ScyllaResultBuffer()
+{
+  close_spill();
+}
+
+/**
+ * Estimate the heap footprint of a decoded row
+ */
+size_t ScyllaResultBuffer::row_footprint(const std::vector<std::string> &row)
+{
+  size_t bytes = sizeof(row) + row.capacity() * sizeof(std::string);
+  for (const std::string &col : row) {
+    // Short strings live inside the std::string object itself
+    if (col.capacity() > sizeof(std::string)) {
+      bytes += col.capacity() + 1;
+    }
+  }
+  return bytes;
+}
+
+/**
+ * Drop all rows and configure the buffer for a new result
+ */
+void ScyllaResultBuffer::reset(size_t budget, const std::string &dir)
+{
+  close_spill();
+
+  // Release the memory instead of only clearing, large scans can leave
+  // a lot of capacity behind
+  std::vector<std::vector<std::string>>().swap(rows);
+  std::vector<uint64_t>().swap(spill_offsets);
+  std::string().swap(write_buffer);
+
+  memory_budget = budget;
+  memory_bytes = 0;
+  spill_errno = 0;
+  spill_dir = dir;
+}
+
+/**
+ * Create the spill file; it is unlinked right away so it disappears
+ * with the descriptor even if the server crashes
+ */
+bool ScyllaResultBuffer::open_spill_file()
+{
+  std::string path = spill_dir.empty() ? "/tmp" : spill_dir;
+  path += "/scylla_spill_XXXXXX";
+
+  std::vector<char> tmpl(path.begin(), path.end());
+  tmpl.push_back('\0');
+
+  int fd = mkstemp(tmpl.data());
+  if (fd < 0) {
+    spill_errno = errno;
+    return false;
+  }
+  unlink(tmpl.data());
+
+  spill_fd = fd;
+  spill_length = 0;
+  return true;
+}
+
+/**
+ * Write pending encoded rows to the spill file
+ */
+bool ScyllaResultBuffer::flush_spill()
+{
+  const char *data = write_buffer.data();
+  size_t remaining = write_buffer.size();
+
+  while (remaining > 0) {
+    ssize_t written = write(spill_fd, data, remaining);
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      spill_errno = errno;
+      return false;
+    }
+    data += written;
+    remaining -= written;
+    spill_length += written;
+  }
+
+  write_buffer.clear();
+  return true;
+}
+
+/**
+ * Map the whole spill file for reading
+ */
+bool ScyllaResultBuffer::remap()
+{
+  if (map_base) {
+    munmap(const_cast<unsigned char *>(map_base), map_length);
+    map_base = nullptr;
+    map_length = 0;
+  }
+
+  if (spill_length == 0) {
+    return true;
+  }
+
+  void *addr = mmap(nullptr, spill_length, PROT_READ, MAP_SHARED, spill_fd, 0);
+  if (addr == MAP_FAILED) {
+    spill_errno = errno;
+    return false;
+  }
+
+  map_base = static_cast<const unsigned char *>(addr);
+  map_length = spill_length;
+  return true;
+}
+
+/**
+ * Unmap and close the spill file
+ */
+void ScyllaResultBuffer::close_spill()
+{
+  if (map_base) {
+    munmap(const_cast<unsigned char *>(map_base), map_length);
+    map_base = nullptr;
+    map_length = 0;
+  }
+
+  if (spill_fd >= 0) {
+    ::close(spill_fd);
+    spill_fd = -1;
+  }
+
+  spill_length = 0;
+  scratch_row.clear();
+}
+
+/**
+ * Append a row, spilling it to disk if the memory budget is exhausted
+ */
+bool ScyllaResultBuffer::append(std::vector<std::string> &row)
+{
+  size_t footprint = row_footprint(row);
+
+  if (!is_spilled() &&
+      (memory_budget == 0 || memory_bytes + footprint <= memory_budget)) {
+    memory_bytes += footprint;
+    rows.push_back(std::move(row));
+    return true;
+  }
+
+  if (!is_spilled() && !open_spill_file()) {
+    return false;
+  }
+
+  // Once spilling started every later row goes to the file so that row
+  // indexes stay contiguous: [0, rows.size()) in memory, the rest on disk
+  spill_offsets.push_back(spill_length + write_buffer.size());
+
+  uint32_t count = static_cast<uint32_t>(row.size());
+  write_buffer.append(reinterpret_cast<const char *>(&count), sizeof(count));
+  for (const std::string &col : row) {
+    uint32_t len = static_cast<uint32_t>(col.size());
+    write_buffer.append(reinterpret_cast<const char *>(&len), sizeof(len));
+    write_buffer.append(col);
+  }
+
+  if (write_buffer.size() >= SPILL_FLUSH_SIZE) {
+    return flush_spill();
+  }
+
+  return true;
+}
+
+/**
+ * Decode a spilled row from the mapped file into scratch_row
+ */
+bool ScyllaResultBuffer::decode_spilled_row(size_t spill_index)
+{
+  uint64_t offset = spill_offsets[spill_index];
+  uint64_t end = (spill_index + 1 < spill_offsets.size())
+                   ? spill_offsets[spill_index + 1]
+                   : spill_length + write_buffer.size();
+
+  // Rows appended since the last mapping need to be flushed and mapped
+  if (end > map_length) {
+    if (!flush_spill() || !remap()) {
+      return false;
+    }
+    if (end > map_length) {
+      spill_errno = EIO;
+      return false;
+    }
+  }
+
+  const unsigned char *p = map_base + offset;
+  const unsigned char *limit = map_base + end;
+  uint32_t count;
+
+  // A record running past its end means the spill file is damaged
+  if (p + sizeof(count) > limit) {
+    spill_errno = EIO;
+    return false;
+  }
+  memcpy(&count, p, sizeof(count));
+  p += sizeof(count);
+
+  scratch_row.resize(count);
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t len;
+    if (p + sizeof(len) > limit) {
+      spill_errno = EIO;
+      return false;
+    }
+    memcpy(&len, p, sizeof(len));
+    p += sizeof(len);
+    if (p + len > limit) {
+      spill_errno = EIO;
+      return false;
+    }
+    scratch_row[i].assign(reinterpret_cast<const char *>(p), len);
+    p += len;
+  }
+
+  return true;
+}
+
+/**
+ * Get a row by index
+ */
+const std::vector<std::string> *ScyllaResultBuffer::get_row(size_t index)
+{
+  if (index < rows.size()) {
+    return &rows[index];
+  }
+
+  size_t spill_index = index - rows.size();
+  if (spill_index >= spill_offsets.size()) {
+    return nullptr;
+  }
+
+  if (!decode_spilled_row(spill_index)) {
+    return nullptr;
+  }
+
+  return &scratch_row;
+}
@@ -0,0 +1,112 @@
+/*
+   Copyright (c) 2025, MariaDB ScyllaDB Storage Engine
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; version 2 of the License.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+#ifndef SCYLLA_RESULT_BUFFER_H
+#define SCYLLA_RESULT_BUFFER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * ScyllaResultBuffer - Buffered CQL result rows addressable by row index
+ *
+ * Rows are kept in memory until the configured memory budget is exceeded.
+ * After that, further rows are appended to an unlinked temporary file in a
+ * compact binary format and read back through a read-only memory mapping,
+ * so rnd_pos() can still reposition anywhere in very large scans.
+ *
+ * Spilled row layout: uint32 column count, then for each column a uint32
+ * length followed by the raw bytes.
+ */
+class ScyllaResultBuffer
+{
+private:
+  std::vector<std::vector<std::string>> rows;  // Rows held in memory
+  size_t memory_budget;                        // 0 means never spill
+  size_t memory_bytes;                         // Estimated size of rows
+  std::string spill_dir;                       // Directory for the spill file
+
+  // Spill file state
+  int spill_fd;
+  int spill_errno;                             // errno of the last spill failure
+  uint64_t spill_length;                       // Bytes flushed to the file
+  std::vector<uint64_t> spill_offsets;         // File offset of each spilled row
+  std::string write_buffer;                    // Encoded rows not yet flushed
+  const unsigned char *map_base;
+  size_t map_length;
+  std::vector<std::string> scratch_row;        // Last row decoded from file
+
+  bool open_spill_file();
+  bool flush_spill();
+  bool remap();
+  void close_spill();
+  bool decode_spilled_row(size_t spill_index);
+
+public:
+  ScyllaResultBuffer();
+  ~ScyllaResultBuffer();
+
+  // Prevent copying
+  ScyllaResultBuffer(const ScyllaResultBuffer&) = delete;
+  ScyllaResultBuffer& operator=(const ScyllaResultBuffer&) = delete;
+
+  /**
+   * Drop all rows and configure the buffer for a new result
+   * @param budget In-memory budget in bytes before spilling (0 = unlimited)
+   * @param dir Directory for the spill file
+   */
+  void reset(size_t budget = 0, const std::string &dir = "");
+
+  /**
+   * Append a row, spilling it to disk if the memory budget is exhausted
+   * @param row Row to append (moved from)
+   * @return true if successful, false if the spill file could not be written
+   */
+  bool append(std::vector<std::string> &row);
+
+  /**
+   * Get a row by index
+   * @param index Row index in append order
+   * @return Pointer to the row, or NULL if out of range or unreadable.
+   *         Rows read from the spill file stay valid until the next call.
+   */
+  const std::vector<std::string> *get_row(size_t index);
+
+  /**
+   * Send every further row to the spill file, whatever the budget
+   */
+  void spill_from_now() { memory_budget = memory_bytes ? memory_bytes : 1; }
+
+  size_t size() const { return rows.size() + spill_offsets.size(); }
+  bool empty() const { return size() == 0; }
+  bool is_spilled() const { return spill_fd >= 0; }
+  size_t memory_used() const { return memory_bytes + write_buffer.capacity(); }
+  uint64_t spilled_bytes() const { return spill_length + write_buffer.size(); }
+
+  /**
+   * errno saved when the spill file could not be created, written or mapped
+   */
+  int spill_error() const { return spill_errno; }
+
+  /**
+   * Estimate the heap footprint of a decoded row
+   */
+  static size_t row_footprint(const std::vector<std::string> &row);
+};
+
+#endif // SCYLLA_RESULT_BUFFER_H
@@ -0,0 +1,234 @@
+/*
+   Copyright (c) 2025, MariaDB ScyllaDB Storage Engine
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; version 2 of the License.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+#include "scylla_row_cache.h"
+#include "scylla_result_buffer.h"
+#include <functional>
+#include <iterator>
+
+/**
+ * Constructor
+ */
+ScyllaRowCache::ScyllaRowCache()
+  : hits(0),
+    misses(0),
+    evictions(0),
+    invalidations(0),
+    capacity_bytes(0),
+    used_bytes(0)
+{
+}
+
+/**
+ * Estimate the memory held by a cached entry
+ */
+size_t ScyllaRowCache::entry_footprint(const std::string &key, const Entry &entry)
+{
+  size_t bytes = sizeof(Node) + sizeof(Entry) + 2 * key.capacity() + 64;
+  bytes += ScyllaResultBuffer::row_footprint(entry.column_names);
+  for (const std::vector<std::string> &row : entry.rows) {
+    bytes += ScyllaResultBuffer::row_footprint(row);
+  }
+  return bytes;
+}
+
+/**
+ * Pick the shard of a key
+ */
+ScyllaRowCache::Shard &ScyllaRowCache::shard_for(const std::string &key)
+{
+  return shards[std::hash<std::string>()(key) % SHARD_COUNT];
+}
+
+/**
+ * Remove a node; the shard lock must be held
+ */
+void ScyllaRowCache::erase_locked(Shard &shard, std::list<Node>::iterator it)
+{
+  shard.bytes -= it->bytes;
+  used_bytes -= it->bytes;
+  shard.index.erase(it->key);
+
+  if (!it->tag.empty()) {
+    typedef std::unordered_multimap<std::string, std::list<Node>::iterator>::iterator TagIter;
+    std::pair<TagIter, TagIter> range = shard.tags.equal_range(it->tag);
+    for (TagIter tag_it = range.first; tag_it != range.second; ++tag_it) {
+      if (tag_it->second == it) {
+        shard.tags.erase(tag_it);
+        break;
+      }
+    }
+  }
+
+  shard.lru.erase(it);
+}
+
+/**
+ * Evict least recently used nodes until the shard fits the limit
+ */
+void ScyllaRowCache::evict_locked(Shard &shard, size_t limit)
+{
+  while (shard.bytes > limit && !shard.lru.empty()) {
+    erase_locked(shard, std::prev(shard.lru.end()));
+    evictions++;
+  }
+}
+
+/**
+ * Set the total size in bytes, evicting entries if needed
+ */
+void ScyllaRowCache::set_capacity(size_t bytes)
+{
+  capacity_bytes = bytes;
+
+  for (size_t i = 0; i < SHARD_COUNT; i++) {
+    std::lock_guard<std::mutex> lock(shards[i].mtx);
+    evict_locked(shards[i], bytes / SHARD_COUNT);
+  }
+}
+
+/**
+ * Look up a key
+ */
+ScyllaRowCache::EntryPtr ScyllaRowCache::lookup(const std::string &key, uint64_t *ticket)
+{
+  Shard &shard = shard_for(key);
+  std::lock_guard<std::mutex> lock(shard.mtx);
+
+  std::unordered_map<std::string, std::list<Node>::iterator>::iterator it =
+    shard.index.find(key);
+
+  if (it != shard.index.end()) {
+    if (it->second->expires > Clock::now()) {
+      // Move to the front of the LRU list
+      shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+      hits++;
+      return it->second->entry;
+    }
+
+    erase_locked(shard, it->second);
+    evictions++;
+  }
+
+  misses++;
+  *ticket = shard.sequence;
+  return EntryPtr();
+}
+
+/**
+ * Cache the result of a lookup that missed
+ */
+void ScyllaRowCache::insert(const std::string &key, const EntryPtr &entry,
+                            unsigned long ttl_ms, uint64_t ticket, const std::string &tag)
+{
+  size_t limit = capacity_bytes / SHARD_COUNT;
+  size_t bytes = entry_footprint(key, *entry) + 2 * tag.capacity();
+  if (bytes > limit) {
+    return;
+  }
+
+  Shard &shard = shard_for(key);
+  std::lock_guard<std::mutex> lock(shard.mtx);
+
+  // The key (or a neighbour in the shard) was written while the row was
+  // being read; what was read may already be stale
+  if (shard.sequence != ticket) {
+    return;
+  }
+
+  std::unordered_map<std::string, std::list<Node>::iterator>::iterator it =
+    shard.index.find(key);
+  if (it != shard.index.end()) {
+    erase_locked(shard, it->second);
+  }
+
+  Node node;
+  node.key = key;
+  node.tag = tag;
+  node.entry = entry;
+  node.expires = Clock::now() + std::chrono::milliseconds(ttl_ms);
+  node.bytes = bytes;
+
+  shard.lru.push_front(node);
+  shard.index[key] = shard.lru.begin();
+  if (!tag.empty()) {
+    shard.tags.insert(std::make_pair(tag, shard.lru.begin()));
+  }
+  shard.bytes += bytes;
+  used_bytes += bytes;
+
+  evict_locked(shard, limit);
+}
+
+/**
+ * Drop a key
+ */
+void ScyllaRowCache::invalidate(const std::string &key)
+{
+  Shard &shard = shard_for(key);
+  std::lock_guard<std::mutex> lock(shard.mtx);
+
+  shard.sequence++;
+
+  std::unordered_map<std::string, std::list<Node>::iterator>::iterator it =
+    shard.index.find(key);
+  if (it != shard.index.end()) {
+    erase_locked(shard, it->second);
+    invalidations++;
+  }
+}
+
+/**
+ * Drop every entry carrying one of the tags. Tagged entries can live in any
+ * shard, so every shard is visited once for the whole batch.
+ */
+void ScyllaRowCache::invalidate_tags(const std::vector<std::string> &tags)
+{
+  if (tags.empty()) {
+    return;
+  }
+
+  for (size_t i = 0; i < SHARD_COUNT; i++) {
+    Shard &shard = shards[i];
+    std::lock_guard<std::mutex> lock(shard.mtx);
+
+    shard.sequence++;
+    for (const std::string &tag : tags) {
+      std::unordered_multimap<std::string, std::list<Node>::iterator>::iterator it;
+      while ((it = shard.tags.find(tag)) != shard.tags.end()) {
+        erase_locked(shard, it->second);
+        invalidations++;
+      }
+    }
+  }
+}
+
+/**
+ * Drop every entry
+ */
+void ScyllaRowCache::clear()
+{
+  for (size_t i = 0; i < SHARD_COUNT; i++) {
+    Shard &shard = shards[i];
+    std::lock_guard<std::mutex> lock(shard.mtx);
+
+    shard.sequence++;
+    while (!shard.lru.empty()) {
+      erase_locked(shard, shard.lru.begin());
+    }
+  }
+}
@@ -0,0 +1,150 @@
+/*
+   Copyright (c) 2025, MariaDB ScyllaDB Storage Engine
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; version 2 of the License.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+#ifndef SCYLLA_ROW_CACHE_H
+#define SCYLLA_ROW_CACHE_H
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * ScyllaRowCache - Size-bounded LRU cache of primary key lookup results
+ *
+ * Keys identify a table and a primary key value. The cache is split into
+ * shards, each with its own lock and LRU list, so concurrent lookups on
+ * different keys rarely contend. Entries expire after a per-insert TTL and
+ * are dropped explicitly when the engine writes the key.
+ *
+ * A lookup miss returns a ticket; insert() ignores the result if the key's
+ * shard saw an invalidation since, so a read racing with a write cannot
+ * put the old row back.
+ *
+ * Entries may carry a tag naming the row by its CQL primary key values, so
+ * changes seen elsewhere (CDC) can invalidate them without the key image.
+ */
+class ScyllaRowCache
+{
+public:
+  /**
+   * Cached result of one lookup (possibly no rows)
+   */
+  struct Entry
+  {
+    std::vector<std::string> column_names;
+    std::vector<std::vector<std::string>> rows;
+  };
+
+  typedef std::shared_ptr<const Entry> EntryPtr;
+
+  static const size_t SHARD_COUNT = 16;
+
+  // Counters
+  std::atomic<uint64_t> hits;
+  std::atomic<uint64_t> misses;
+  std::atomic<uint64_t> evictions;        // Dropped for space or expired
+  std::atomic<uint64_t> invalidations;    // Dropped by writes
+
+  ScyllaRowCache();
+
+  // Prevent copying
+  ScyllaRowCache(const ScyllaRowCache&) = delete;
+  ScyllaRowCache& operator=(const ScyllaRowCache&) = delete;
+
+  /**
+   * Set the total size in bytes, evicting entries if needed (0 disables)
+   */
+  void set_capacity(size_t bytes);
+
+  bool enabled() const { return capacity_bytes.load(std::memory_order_relaxed) > 0; }
+  size_t memory_used() const { return used_bytes.load(std::memory_order_relaxed); }
+
+  /**
+   * Look up a key
+   * @param key Cache key
+   * @param ticket Set on a miss, to be passed to insert()
+   * @return Cached entry, or NULL on a miss
+   */
+  EntryPtr lookup(const std::string &key, uint64_t *ticket);
+
+  /**
+   * Cache the result of a lookup that missed
+   * @param key Cache key
+   * @param entry Result to cache
+   * @param ttl_ms Time to live in milliseconds
+   * @param ticket Ticket returned by the lookup() that missed
+   * @param tag Optional tag for invalidate_tags()
+   */
+  void insert(const std::string &key, const EntryPtr &entry, unsigned long ttl_ms,
+              uint64_t ticket, const std::string &tag = std::string());
+
+  /**
+   * Drop a key, e.g. after the row was written
+   */
+  void invalidate(const std::string &key);
+
+  /**
+   * Drop every entry carrying one of the tags
+   */
+  void invalidate_tags(const std::vector<std::string> &tags);
+
+  /**
+   * Drop every entry
+   */
+  void clear();
+
+private:
+  typedef std::chrono::steady_clock Clock;
+
+  struct Node
+  {
+    std::string key;
+    std::string tag;
+    EntryPtr entry;
+    Clock::time_point expires;
+    size_t bytes;
+  };
+
+  struct Shard
+  {
+    std::mutex mtx;
+    std::list<Node> lru;                  // Most recently used first
+    std::unordered_map<std::string, std::list<Node>::iterator> index;
+    std::unordered_multimap<std::string, std::list<Node>::iterator> tags;
+    size_t bytes;
+    uint64_t sequence;                    // Bumped by every invalidation
+
+    Shard() : bytes(0), sequence(0) {}
+  };
+
+  Shard shards[SHARD_COUNT];
+  std::atomic<size_t> capacity_bytes;
+  std::atomic<size_t> used_bytes;
+
+  Shard &shard_for(const std::string &key);
+  void erase_locked(Shard &shard, std::list<Node>::iterator it);
+  void evict_locked(Shard &shard, size_t limit);
+  static size_t entry_footprint(const std::string &key, const Entry &entry);
+};
+
+#endif // SCYLLA_ROW_CACHE_H
@@ -0,0 +1,98 @@
+/*
+   Copyright (c) 2025, MariaDB ScyllaDB Storage Engine
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; version 2 of the License.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+#include "scylla_single_flight.h"
+#include "scylla_async.h"
+#include <functional>
+
+/**
+ * Pick the shard of a key
+ */
+ScyllaSingleFlight::Shard &ScyllaSingleFlight::shard_for(const std::string &key)
+{
+  return shards[std::hash<std::string>()(key) % SHARD_COUNT];
+}
+
+/**
+ * Join the in-flight read of a key, or start one
+ */
+ScyllaSingleFlight::CallPtr ScyllaSingleFlight::join(const std::string &key, bool *leader)
+{
+  Shard &shard = shard_for(key);
+  std::lock_guard<std::mutex> lock(shard.mtx);
+
+  std::unordered_map<std::string, CallPtr>::iterator it = shard.calls.find(key);
+  if (it != shard.calls.end()) {
+    *leader = false;
+    return it->second;
+  }
+
+  CallPtr call = std::make_shared<Call>();
+  shard.calls[key] = call;
+  *leader = true;
+  return call;
+}
+
+/**
+ * Publish the leader's result and wake the waiting readers
+ */
+void ScyllaSingleFlight::complete(const std::string &key, const CallPtr &call,
+                                  const ScyllaRowCache::EntryPtr &result)
+{
+  {
+    Shard &shard = shard_for(key);
+    std::lock_guard<std::mutex> lock(shard.mtx);
+
+    // A write may already have replaced the call with a newer one
+    std::unordered_map<std::string, CallPtr>::iterator it = shard.calls.find(key);
+    if (it != shard.calls.end() && it->second == call) {
+      shard.calls.erase(it);
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(call->mtx);
+  call->result = result;
+  call->done = true;
+  call->done_cond.notify_all();
+}
+
+/**
+ * Wait for the leader's result
+ */
+ScyllaRowCache::EntryPtr ScyllaSingleFlight::wait(const CallPtr &call)
+{
+  // The leader is waiting on ScyllaDB for us
+  std::unique_lock<std::mutex> lock(call->mtx);
+  if (!ScyllaWait::wait(lock, call->done_cond, [&call] { return call->done; })) {
+    return ScyllaRowCache::EntryPtr();
+  }
+
+  if (call->result) {
+    coalesced++;
+  }
+  return call->result;
+}
+
+/**
+ * Detach the in-flight read of a key after the key was written
+ */
+void ScyllaSingleFlight::invalidate(const std::string &key)
+{
+  Shard &shard = shard_for(key);
+  std::lock_guard<std::mutex> lock(shard.mtx);
+  shard.calls.erase(key);
+}
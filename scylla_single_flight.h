@@ -0,0 +1,111 @@
+/*
+   Copyright (c) 2025, MariaDB ScyllaDB Storage Engine
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; version 2 of the License.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+#ifndef SCYLLA_SINGLE_FLIGHT_H
+#define SCYLLA_SINGLE_FLIGHT_H
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "scylla_row_cache.h"
+
+/**
+ * ScyllaSingleFlight - Coalescing of identical concurrent point reads
+ *
+ * The first reader of a key becomes the leader of a call and queries
+ * ScyllaDB; readers of the same key arriving while the call is in flight
+ * wait for the leader's result instead of sending their own request.
+ *
+ * A write to the key detaches the in-flight call, so readers arriving
+ * after the write start a new call and see their own writes.
+ */
+class ScyllaSingleFlight
+{
+public:
+  /**
+   * One in-flight read
+   */
+  struct Call
+  {
+    std::mutex mtx;
+    std::condition_variable done_cond;
+    bool done;
+    ScyllaRowCache::EntryPtr result;  // NULL if the leader failed
+
+    Call() : done(false) {}
+  };
+
+  typedef std::shared_ptr<Call> CallPtr;
+
+  static const size_t SHARD_COUNT = 16;
+
+  std::atomic<uint64_t> coalesced;      // Reads answered by another reader's call
+
+  ScyllaSingleFlight() : coalesced(0) {}
+
+  // Prevent copying
+  ScyllaSingleFlight(const ScyllaSingleFlight&) = delete;
+  ScyllaSingleFlight& operator=(const ScyllaSingleFlight&) = delete;
+
+  /**
+   * Join the in-flight read of a key, or start one
+   * @param key Read key (table, statement shape and bound key)
+   * @param leader Set to true if the caller must run the read and
+   *        call complete(), false if it should wait()
+   * @return The call
+   */
+  CallPtr join(const std::string &key, bool *leader);
+
+  /**
+   * Publish the leader's result and wake the waiting readers
+   * @param key Read key passed to join()
+   * @param call Call returned by join()
+   * @param result Result, or NULL if the read failed
+   */
+  void complete(const std::string &key, const CallPtr &call,
+                const ScyllaRowCache::EntryPtr &result);
+
+  /**
+   * Wait for the leader's result
+   * @return Result, or NULL if the leader failed or the caller was
+   *         interrupted; the caller should then read on its own
+   */
+  ScyllaRowCache::EntryPtr wait(const CallPtr &call);
+
+  /**
+   * Detach the in-flight read of a key after the key was written
+   */
+  void invalidate(const std::string &key);
+
+private:
+  struct Shard
+  {
+    std::mutex mtx;
+    std::unordered_map<std::string, CallPtr> calls;
+  };
+
+  Shard shards[SHARD_COUNT];
+
+  Shard &shard_for(const std::string &key);
+};
+
+#endif // SCYLLA_SINGLE_FLIGHT_H
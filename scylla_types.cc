@@ -85,6 +85,40 @@ std::string ScyllaTypes::mariadb_to_cql_type(Field *field)
   }
 }
 
+/**
+ * Convert a temporal field to a Unix timestamp in milliseconds for ScyllaDB
+ */
+static long long timestamp_ms(Field *field)
+{
+  MYSQL_TIME ltime;
+  field->get_date(&ltime, date_mode_t(0));
+  
+  struct tm tm_struct;
+  memset(&tm_struct, 0, sizeof(tm_struct));
+  tm_struct.tm_year = ltime.year - 1900;
+  tm_struct.tm_mon = ltime.month - 1;
+  tm_struct.tm_mday = ltime.day;
+  tm_struct.tm_hour = ltime.hour;
+  tm_struct.tm_min = ltime.minute;
+  tm_struct.tm_sec = ltime.second;
+  
+  time_t timestamp = mktime(&tm_struct);
+  return timestamp * 1000LL + ltime.second_part / 1000;
+}
+
+/**
+ * Days since 1970-01-01 of a proleptic Gregorian date
+ */
+static long days_from_civil(long year, unsigned month, unsigned day)
+{
+  year -= month <= 2;
+  long era = (year >= 0 ? year : year - 399) / 400;
+  unsigned yoe = static_cast<unsigned>(year - era * 400);
+  unsigned doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + static_cast<long>(doe) - 719468;
+}
+
 /**
  * Get the CQL value representation of a MariaDB field
  */
@@ -182,20 +216,7 @@ std::string ScyllaTypes::get_cql_value(Field *field)
     case MYSQL_TYPE_DATETIME:
     case MYSQL_TYPE_TIMESTAMP:
     case MYSQL_TYPE_TIMESTAMP2: {
-      MYSQL_TIME ltime;
-      field->get_date(&ltime, date_mode_t(0));
-      // Convert to Unix timestamp in milliseconds for ScyllaDB
-      struct tm tm_struct;
-      memset(&tm_struct, 0, sizeof(tm_struct));
-      tm_struct.tm_year = ltime.year - 1900;
-      tm_struct.tm_mon = ltime.month - 1;
-      tm_struct.tm_mday = ltime.day;
-      tm_struct.tm_hour = ltime.hour;
-      tm_struct.tm_min = ltime.minute;
-      tm_struct.tm_sec = ltime.second;
-      
-      time_t timestamp = mktime(&tm_struct);
-      oss << (timestamp * 1000LL + ltime.second_part / 1000);
+      oss << timestamp_ms(field);
       break;
     }
     
@@ -216,6 +237,229 @@ std::string ScyllaTypes::get_cql_value(Field *field)
   return oss.str();
 }
 
+/**
+ * Bind the value of a MariaDB field to a prepared statement parameter
+ */
+bool ScyllaTypes::bind_field_value(CassStatement *statement, size_t index,
+                                   Field *field, CassValueType cql_type)
+{
+  if (field->is_null()) {
+    return cass_statement_bind_null(statement, index) == CASS_OK;
+  }
+  
+  CassError rc;
+  
+  switch (cql_type) {
+    case CASS_VALUE_TYPE_TINY_INT:
+      rc = cass_statement_bind_int8(statement, index, (cass_int8_t) field->val_int());
+      break;
+    case CASS_VALUE_TYPE_SMALL_INT:
+      rc = cass_statement_bind_int16(statement, index, (cass_int16_t) field->val_int());
+      break;
+    case CASS_VALUE_TYPE_INT:
+      rc = cass_statement_bind_int32(statement, index, (cass_int32_t) field->val_int());
+      break;
+    case CASS_VALUE_TYPE_BIGINT:
+      rc = cass_statement_bind_int64(statement, index, (cass_int64_t) field->val_int());
+      break;
+    case CASS_VALUE_TYPE_FLOAT:
+      rc = cass_statement_bind_float(statement, index, (cass_float_t) field->val_real());
+      break;
+    case CASS_VALUE_TYPE_DOUBLE:
+      rc = cass_statement_bind_double(statement, index, field->val_real());
+      break;
+    case CASS_VALUE_TYPE_BOOLEAN:
+      rc = cass_statement_bind_bool(statement, index, field->val_int() ? cass_true : cass_false);
+      break;
+    
+    case CASS_VALUE_TYPE_TIMESTAMP: {
+      // Same conversion as get_cql_value(); integer columns hold milliseconds
+      switch (field->type()) {
+        case MYSQL_TYPE_DATE:
+        case MYSQL_TYPE_DATETIME:
+        case MYSQL_TYPE_TIMESTAMP:
+        case MYSQL_TYPE_TIMESTAMP2:
+          rc = cass_statement_bind_int64(statement, index, timestamp_ms(field));
+          break;
+        default:
+          rc = cass_statement_bind_int64(statement, index, (cass_int64_t) field->val_int());
+          break;
+      }
+      break;
+    }
+    
+    case CASS_VALUE_TYPE_DATE: {
+      // CQL date counts days with 2^31 as 1970-01-01
+      MYSQL_TIME ltime;
+      field->get_date(&ltime, date_mode_t(0));
+      long days = days_from_civil(ltime.year, ltime.month, ltime.day);
+      rc = cass_statement_bind_uint32(statement, index,
+                                      (cass_uint32_t) (2147483648LL + days));
+      break;
+    }
+    
+    case CASS_VALUE_TYPE_TIME: {
+      // CQL time is nanoseconds since midnight
+      MYSQL_TIME ltime;
+      field->get_date(&ltime, date_mode_t(0));
+      cass_int64_t nanos = ((ltime.hour * 60LL + ltime.minute) * 60LL + ltime.second) *
+                           1000000000LL + ltime.second_part * 1000LL;
+      rc = cass_statement_bind_int64(statement, index, nanos);
+      break;
+    }
+    
+    case CASS_VALUE_TYPE_TEXT:
+    case CASS_VALUE_TYPE_VARCHAR:
+    case CASS_VALUE_TYPE_ASCII: {
+      String str;
+      field->val_str(&str);
+      rc = cass_statement_bind_string_n(statement, index, str.ptr(), str.length());
+      break;
+    }
+    
+    case CASS_VALUE_TYPE_BLOB: {
+      String str;
+      field->val_str(&str);
+      rc = cass_statement_bind_bytes(statement, index,
+                                     reinterpret_cast<const cass_byte_t*>(str.ptr()),
+                                     str.length());
+      break;
+    }
+    
+    default:
+      return false;
+  }
+  
+  return rc == CASS_OK;
+}
+
+/**
+ * Append an integer in network byte order
+ */
+static void append_big_endian(std::string &out, unsigned long long value, int bytes)
+{
+  for (int shift = (bytes - 1) * 8; shift >= 0; shift -= 8) {
+    out += (char) ((value >> shift) & 0xff);
+  }
+}
+
+/**
+ * Append the native protocol serialization of a field value; the
+ * conversions match bind_field_value()
+ */
+bool ScyllaTypes::serialize_field_value(Field *field, CassValueType cql_type, std::string &out)
+{
+  if (field->is_null()) {
+    return false;
+  }
+  
+  switch (cql_type) {
+    case CASS_VALUE_TYPE_TINY_INT:
+      append_big_endian(out, (unsigned long long) field->val_int(), 1);
+      return true;
+    case CASS_VALUE_TYPE_SMALL_INT:
+      append_big_endian(out, (unsigned long long) field->val_int(), 2);
+      return true;
+    case CASS_VALUE_TYPE_INT:
+      append_big_endian(out, (unsigned long long) field->val_int(), 4);
+      return true;
+    case CASS_VALUE_TYPE_BIGINT:
+      append_big_endian(out, (unsigned long long) field->val_int(), 8);
+      return true;
+    case CASS_VALUE_TYPE_BOOLEAN:
+      append_big_endian(out, field->val_int() ? 1 : 0, 1);
+      return true;
+    
+    case CASS_VALUE_TYPE_FLOAT: {
+      float value = (float) field->val_real();
+      uint32_t bits;
+      memcpy(&bits, &value, sizeof(bits));
+      append_big_endian(out, bits, 4);
+      return true;
+    }
+    
+    case CASS_VALUE_TYPE_DOUBLE: {
+      double value = field->val_real();
+      uint64_t bits;
+      memcpy(&bits, &value, sizeof(bits));
+      append_big_endian(out, bits, 8);
+      return true;
+    }
+    
+    case CASS_VALUE_TYPE_TIMESTAMP:
+      switch (field->type()) {
+        case MYSQL_TYPE_DATE:
+        case MYSQL_TYPE_DATETIME:
+        case MYSQL_TYPE_TIMESTAMP:
+        case MYSQL_TYPE_TIMESTAMP2:
+          append_big_endian(out, (unsigned long long) timestamp_ms(field), 8);
+          break;
+        default:
+          append_big_endian(out, (unsigned long long) field->val_int(), 8);
+          break;
+      }
+      return true;
+    
+    case CASS_VALUE_TYPE_DATE: {
+      MYSQL_TIME ltime;
+      field->get_date(&ltime, date_mode_t(0));
+      long days = days_from_civil(ltime.year, ltime.month, ltime.day);
+      append_big_endian(out, (unsigned long long) (2147483648LL + days), 4);
+      return true;
+    }
+    
+    case CASS_VALUE_TYPE_TIME: {
+      MYSQL_TIME ltime;
+      field->get_date(&ltime, date_mode_t(0));
+      long long nanos = ((ltime.hour * 60LL + ltime.minute) * 60LL + ltime.second) *
+                        1000000000LL + ltime.second_part * 1000LL;
+      append_big_endian(out, (unsigned long long) nanos, 8);
+      return true;
+    }
+    
+    case CASS_VALUE_TYPE_TEXT:
+    case CASS_VALUE_TYPE_VARCHAR:
+    case CASS_VALUE_TYPE_ASCII:
+    case CASS_VALUE_TYPE_BLOB: {
+      String str;
+      field->val_str(&str);
+      out.append(str.ptr(), str.length());
+      return true;
+    }
+    
+    default:
+      return false;
+  }
+}
+
+/**
+ * Check if values can be bound to a parameter of this CQL type
+ */
+bool ScyllaTypes::can_bind(CassValueType cql_type)
+{
+  switch (cql_type) {
+    case CASS_VALUE_TYPE_TINY_INT:
+    case CASS_VALUE_TYPE_SMALL_INT:
+    case CASS_VALUE_TYPE_INT:
+    case CASS_VALUE_TYPE_BIGINT:
+    case CASS_VALUE_TYPE_FLOAT:
+    case CASS_VALUE_TYPE_DOUBLE:
+    case CASS_VALUE_TYPE_BOOLEAN:
+    case CASS_VALUE_TYPE_TIMESTAMP:
+    case CASS_VALUE_TYPE_DATE:
+    case CASS_VALUE_TYPE_TIME:
+    case CASS_VALUE_TYPE_TEXT:
+    case CASS_VALUE_TYPE_VARCHAR:
+    case CASS_VALUE_TYPE_ASCII:
+    case CASS_VALUE_TYPE_BLOB:
+      return true;
+    
+    default:
+      // decimal, varint, uuid, inet, ... keep using CQL literals
+      return false;
+  }
+}
+
 /**
  * Store a CQL value into a MariaDB field
  */
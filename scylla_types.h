@@ -22,6 +22,10 @@
 #include <field.h>
 #include <string>
 
+extern "C" {
+  #include <cassandra.h>
+}
+
 /**
  * ScyllaTypes - Utilities for mapping between MariaDB and ScyllaDB data types
  */
@@ -42,6 +46,34 @@ public:
    */
   static std::string get_cql_value(Field *field);
   
+  /**
+   * Bind the value of a MariaDB field to a prepared statement parameter
+   * @param statement Statement created from a prepared statement
+   * @param index Bind marker index
+   * @param field MariaDB field
+   * @param cql_type CQL type of the parameter
+   * @return true if bound, false if the type cannot be bound
+   */
+  static bool bind_field_value(CassStatement *statement, size_t index,
+                               Field *field, CassValueType cql_type);
+  
+  /**
+   * Check if values can be bound to a parameter of this CQL type
+   * @param cql_type CQL type of the parameter
+   * @return true if bind_field_value() supports it
+   */
+  static bool can_bind(CassValueType cql_type);
+  
+  /**
+   * Append the native protocol serialization of a field value, as hashed
+   * into partition tokens
+   * @param field MariaDB field
+   * @param cql_type CQL type of the column
+   * @param out Receives the value bytes
+   * @return false for NULL values and types can_bind() rejects
+   */
+  static bool serialize_field_value(Field *field, CassValueType cql_type, std::string &out);
+  
   /**
    * Store a CQL value into a MariaDB field
    * @param field MariaDB field
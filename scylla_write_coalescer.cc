@@ -0,0 +1,204 @@
+/*
+   Copyright (c) 2025, MariaDB ScyllaDB Storage Engine
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; version 2 of the License.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+#include "scylla_write_coalescer.h"
+#include "scylla_connection.h"
+#include <algorithm>
+#include <map>
+#include <tuple>
+
+std::atomic<unsigned long long> ScyllaWriteCoalescer::batches(0);
+std::atomic<unsigned long long> ScyllaWriteCoalescer::writes(0);
+
+/**
+ * Constructor
+ */
+ScyllaWriteCoalescer::ScyllaWriteCoalescer(ScyllaConnection *conn)
+  : conn(conn)
+{
+}
+
+/**
+ * Send a write together with concurrent writes and wait for it
+ */
+CassError ScyllaWriteCoalescer::write(const Write &write, unsigned int window_us,
+                                      unsigned int max_batch, size_t max_bytes,
+                                      std::string *error)
+{
+  Pending pending;
+  pending.write = &write;
+  pending.done = false;
+  pending.rc = CASS_OK;
+
+  ScyllaWait::Scope waiting;
+  std::unique_lock<std::mutex> lock(mtx);
+  gathered.push_back(&pending);
+
+  if (gathered.size() == 1) {
+    // The first write sends what arrived during its window; writes coming
+    // later start the next window
+    arrived.wait_for(lock, std::chrono::microseconds(window_us),
+                     [this] { return gathered.size() >= MAX_GATHERED; });
+    std::vector<Pending*> writes;
+    writes.swap(gathered);
+    lock.unlock();
+    flush(writes, std::max(max_batch, 1U), max_bytes);
+    lock.lock();
+  } else if (gathered.size() >= MAX_GATHERED) {
+    arrived.notify_all();
+  }
+
+  // Requests time out, so the batch always completes
+  acked.wait(lock, [&pending] { return pending.done; });
+
+  if (pending.rc != CASS_OK && error) {
+    *error = pending.error;
+  }
+  return pending.rc;
+}
+
+/**
+ * Group gathered writes into batches and send them
+ */
+void ScyllaWriteCoalescer::flush(std::vector<Pending*> &writes, unsigned int max_batch,
+                                 size_t max_bytes)
+{
+  // Writes of one group may share a batch: same owner (or same partition
+  // when owners are unknown), consistency, profile and idempotence
+  typedef std::tuple<bool, int64_t, int, std::string, bool> GroupKey;
+  std::map<GroupKey, std::vector<Pending*>> groups;
+
+  for (size_t i = 0; i < writes.size(); i++) {
+    const Write *write = writes[i]->write;
+    int node = conn->token_owner(write->token);
+    GroupKey key(node >= 0, node >= 0 ? node : write->token, (int) write->consistency,
+                 write->profile ? write->profile : "", write->idempotent);
+    groups[key].push_back(writes[i]);
+  }
+
+  for (std::map<GroupKey, std::vector<Pending*>>::iterator it = groups.begin();
+       it != groups.end(); ++it) {
+    std::vector<Pending*> &group = it->second;
+    std::stable_sort(group.begin(), group.end(), [](const Pending *a, const Pending *b) {
+      return a->write->token < b->write->token;
+    });
+
+    // A write larger than max_bytes still goes out, alone
+    size_t start = 0;
+    while (start < group.size()) {
+      size_t end = start;
+      size_t bytes = 0;
+      while (end < group.size() && end - start < max_batch &&
+             (end == start || max_bytes == 0 || bytes + group[end]->write->bytes <= max_bytes)) {
+        bytes += group[end]->write->bytes;
+        end++;
+      }
+      send(std::vector<Pending*>(group.begin() + start, group.begin() + end));
+      start = end;
+    }
+  }
+}
+
+/**
+ * Send writes sharing a group, as one statement or one unlogged batch
+ */
+void ScyllaWriteCoalescer::send(const std::vector<Pending*> &members)
+{
+  const Write *first = members[0]->write;
+  ScyllaFuture future;
+
+  if (members.size() == 1) {
+    future = conn->execute_async(first->statement);
+  } else {
+    CassBatch *batch = cass_batch_new(CASS_BATCH_TYPE_UNLOGGED);
+    for (size_t i = 0; i < members.size(); i++) {
+      cass_batch_add_statement(batch, members[i]->write->statement);
+    }
+    // Batches ignore the settings of their statements
+    if (first->consistency != CASS_CONSISTENCY_UNKNOWN) {
+      cass_batch_set_consistency(batch, first->consistency);
+    }
+    if (first->profile) {
+      cass_batch_set_execution_profile(batch, first->profile);
+    }
+    cass_batch_set_is_idempotent(batch, first->idempotent ? cass_true : cass_false);
+    if (first->idempotent) {
+      // The caller retries idempotent writes itself
+      cass_batch_set_retry_policy(batch, ScyllaRetryPolicy::driver_policy());
+    }
+    // One timestamp for the batch: the latest of its writes, all of which
+    // are still waiting for it
+    int64_t timestamp = 0;
+    for (size_t i = 0; i < members.size(); i++) {
+      timestamp = std::max(timestamp, members[i]->write->timestamp);
+    }
+    if (timestamp) {
+      cass_batch_set_timestamp(batch, timestamp);
+    }
+
+    future = conn->execute_batch_async(batch);
+    cass_batch_free(batch);
+
+    batches++;
+    writes += members.size();
+  }
+
+  if (!future.valid()) {
+    complete(members, CASS_ERROR_LIB_NO_HOSTS_AVAILABLE, "not connected");
+    return;
+  }
+
+  bool started = future.on_ready([this, members](CassFuture *f) {
+    CassError rc = cass_future_error_code(f);
+    std::string message;
+    if (rc != CASS_OK) {
+      const char *text;
+      size_t length;
+      cass_future_error_message(f, &text, &length);
+      message.assign(text, length);
+    }
+    complete(members, rc, message);
+  });
+
+  if (!started) {
+    complete(members, future.error_code(), future.error_message());
+  }
+}
+
+/**
+ * Hand the outcome of a batch to its waiting sessions
+ */
+void ScyllaWriteCoalescer::complete(const std::vector<Pending*> &members, CassError rc,
+                                    const std::string &error)
+{
+  // The batch's error may come from a single write; the others must not
+  // fail with it. Retryable errors are retried by each session anyway
+  if (rc != CASS_OK && members.size() > 1 && !ScyllaRetryPolicy::retryable(rc)) {
+    for (size_t i = 0; i < members.size(); i++) {
+      send(std::vector<Pending*>(1, members[i]));
+    }
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mtx);
+  for (size_t i = 0; i < members.size(); i++) {
+    members[i]->rc = rc;
+    members[i]->error = error;
+    members[i]->done = true;
+  }
+  acked.notify_all();
+}
@@ -0,0 +1,111 @@
+/*
+   Copyright (c) 2025, MariaDB ScyllaDB Storage Engine
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; version 2 of the License.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301  USA
+*/
+
+#ifndef SCYLLA_WRITE_COALESCER_H
+#define SCYLLA_WRITE_COALESCER_H
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+extern "C" {
+  #include <cassandra.h>
+}
+
+class ScyllaConnection;
+
+/**
+ * ScyllaWriteCoalescer - Batches concurrent single-row writes of all
+ * sessions using one cluster connection
+ *
+ * The first write to arrive waits up to a short window for writes of other
+ * sessions, then sends everything gathered: writes are grouped by the node
+ * owning their token (by partition when the ring is unknown) and by their
+ * consistency and profile, sorted by token, and sent as UNLOGGED batches of
+ * at most max_batch writes and max_bytes bytes. Unlogged batches are not
+ * atomic across partitions; each session waits for the batch holding its
+ * write and gets that batch's outcome. A batch failing with an error that
+ * retrying would not fix (e.g. one invalid write) is resent one write at a
+ * time, so each session gets the outcome of its own write.
+ */
+class ScyllaWriteCoalescer
+{
+public:
+  static const size_t MAX_GATHERED = 4096;       // Sent early once this many wait
+
+  static std::atomic<unsigned long long> batches;  // Batches sent
+  static std::atomic<unsigned long long> writes;   // Writes sent in batches
+
+  /**
+   * A write and the settings its batch must share
+   */
+  struct Write
+  {
+    CassStatement *statement;           // Owned by the caller
+    int64_t token;                      // Of the partition written
+    size_t bytes;                       // Estimated size
+    CassConsistency consistency;        // CASS_CONSISTENCY_UNKNOWN = driver default
+    const char *profile;                // Execution profile name
+    bool idempotent;                    // Retried by the caller, not the driver
+    int64_t timestamp;                  // Client timestamp, 0 if none
+  };
+
+  explicit ScyllaWriteCoalescer(ScyllaConnection *conn);
+
+  // Prevent copying
+  ScyllaWriteCoalescer(const ScyllaWriteCoalescer&) = delete;
+  ScyllaWriteCoalescer& operator=(const ScyllaWriteCoalescer&) = delete;
+
+  /**
+   * Send a write together with concurrent writes and wait until it is
+   * acknowledged
+   * @param write Write to send; its statement must stay valid until this
+   *        returns
+   * @param window_us Time the first write waits for others to join it
+   * @param max_batch Writes per batch
+   * @param max_bytes Estimated bytes per batch (0 = no limit)
+   * @param error Receives the driver's message if the write failed
+   * @return Outcome of the batch holding the write
+   */
+  CassError write(const Write &write, unsigned int window_us, unsigned int max_batch,
+                  size_t max_bytes, std::string *error);
+
+private:
+  struct Pending
+  {
+    const Write *write;
+    bool done;
+    CassError rc;
+    std::string error;
+  };
+
+  ScyllaConnection *conn;               // Owns the coalescer
+  std::mutex mtx;
+  std::condition_variable arrived;      // A write joined the gathered ones
+  std::condition_variable acked;        // A batch completed
+  std::vector<Pending*> gathered;
+
+  void flush(std::vector<Pending*> &writes, unsigned int max_batch, size_t max_bytes);
+  void send(const std::vector<Pending*> &members);
+  void complete(const std::vector<Pending*> &members, CassError rc, const std::string &error);
+};
+
+#endif // SCYLLA_WRITE_COALESCER_H